@@ -76,6 +76,13 @@ public:
 	int								searchRadius;
 	double							svmC;
 	int								svmBudgetSize;
+	int								svmBudgetSlack;
+	int								svmCompactAge;
+	double							svmTolerance;
+	int								svmMaxReprocess;
+	int								svmUpdateBudget;
+	bool							asyncUpdate;
+	bool							gaussianFastExp;
 	std::vector<FeatureKernelPair>	features;
 	
 	friend std::ostream& operator<< (std::ostream& out, const Config& conf);
@@ -37,6 +37,7 @@ class Features
 {
 public:
 	Features();
+	virtual ~Features() {}
 		
 	//ѧϰߵľ飬СóչЧʸ
 	inline const Eigen::VectorXd& Eval(const Sample& s) const
@@ -58,6 +59,17 @@ public:
 		}
 	}
 	
+	// one row per sample
+	virtual void Eval(const MultiSample& s, Eigen::MatrixXd& featMat)
+	{
+		// default implementation
+		featMat.resize(s.GetRects().size(), m_featureCount);
+		for (int i = 0; i < featMat.rows(); ++i)
+		{
+			featMat.row(i) = Eval(s.GetSample(i)).transpose();
+		}
+	}
+	
 	inline int GetCount() const { return m_featureCount; }
 
 protected:
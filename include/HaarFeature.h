@@ -30,18 +30,40 @@
 
 #include "Rect.h"
 #include "ImageRep.h"
+#include "Sample.h"
 
 #include <vector>
 
-class Sample;
-
 class HaarFeature
 {
 public:
 	HaarFeature(const FloatRect& bb, int type);
 	~HaarFeature();
 	
-	float Eval(const Sample& s) const;
+	inline float Eval(const Sample& s) const
+	{
+		const ImageRep& image = s.GetImage();
+		const FloatRect& roi = s.GetROI();
+		float value = 0.f;
+		for (int i = 0; i < (int)m_rects.size(); ++i)
+		{
+			const FloatRect& r = m_rects[i];
+			IntRect sampleRect((int)(roi.XMin()+r.XMin()*roi.Width()+0.5f), (int)(roi.YMin()+r.YMin()*roi.Height()+0.5f),
+				(int)(r.Width()*roi.Width()), (int)(r.Height()*roi.Height()));
+			value += m_weights[i]*image.Sum(sampleRect);
+		}
+		return value / (m_factor*roi.Area()*m_bb.Area());
+	}
+	
+	inline int GetRectCount() const { return m_rects.size(); }
+	
+	// what Eval computes for a w x h box at an integer position in an
+	// integral image with the given step: the offsets of the four corners
+	// of each rect from the box's top left (the two added first), their
+	// weights and the factor the sum is divided by. false if the rounding
+	// of some corner in Eval depends on where the box is in a cols x rows
+	// integral image.
+	bool GetOffsets(float w, float h, int step, int cols, int rows, int* offsets, float* weights, float& norm) const;
 	
 private:
 	FloatRect m_bb;
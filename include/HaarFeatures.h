@@ -38,11 +38,91 @@ class Config;
 class HaarFeatures : public Features
 {
 public:
+	static const int kCount = 192;
+	
 	HaarFeatures(const Config& conf);
 	
+	using Features::Eval;
+	virtual void Eval(const MultiSample& s, Eigen::MatrixXd& featMat);
+	
+	// feature d of sample i is written to out[d*stride+i]. boxes next to
+	// each other along a row of the pixel grid are done together with
+	// HaarRow, the others one at a time
+	void Fill(const MultiSample& s, double* out, int stride);
+	
+	// feature d of s is written to out[d*stride], the reference the
+	// batch is checked against
+	inline void Fill(const Sample& s, double* out, int stride)
+	{
+		const FloatRect& roi = s.GetROI();
+		const cv::Mat& integral = s.GetImage().GetIntegralImage();
+		int x = (int)roi.XMin();
+		int y = (int)roi.YMin();
+		if ((float)x != roi.XMin() || (float)y != roi.YMin())
+		{
+			// off the pixel grid the rounding differs from box to box
+			for (int i = 0; i < kCount; ++i)
+			{
+				out[i*stride] = m_features[i].Eval(s);
+			}
+			return;
+		}
+		
+		UseTable(roi, integral);
+		
+		// the same sums and rounding as HaarFeature::Eval, read at fixed
+		// offsets from the box's corner
+		const int* base = integral.ptr<int>(y)+x;
+		for (int i = 0; i < kCount; ++i)
+		{
+			if (!m_table.exact[i])
+			{
+				out[i*stride] = m_features[i].Eval(s);
+				continue;
+			}
+			float value = 0.f;
+			for (int j = m_table.first[i]; j < m_table.first[i+1]; ++j)
+			{
+				const int* o = &m_table.offsets[4*j];
+				value += m_table.weights[j]*(base[o[0]] + base[o[1]] - base[o[2]] - base[o[3]]);
+			}
+			out[i*stride] = value / m_table.norms[i];
+		}
+	}
+	
 private:
+	// integral image offsets for the box size and image they were built
+	// for. a feature whose rounding depends on the box position is not
+	// exact and left to HaarFeature::Eval.
+	struct OffsetTable
+	{
+		OffsetTable() : width(-1.f), height(-1.f), cols(0), rows(0), step(0) {}
+		
+		float width;
+		float height;
+		int cols;
+		int rows;
+		int step;
+		std::vector<int> first; // feature i has rects first[i] to first[i+1]-1
+		std::vector<int> offsets; // four corners per rect
+		std::vector<float> weights;
+		std::vector<float> norms;
+		std::vector<char> exact;
+	};
+	
 	std::vector<HaarFeature> m_features;
+	OffsetTable m_table;
+	
+	inline void UseTable(const FloatRect& roi, const cv::Mat& integral)
+	{
+		if (roi.Width() != m_table.width || roi.Height() != m_table.height ||
+			integral.cols != m_table.cols || integral.rows != m_table.rows || (int)integral.step1() != m_table.step)
+		{
+			BuildTable(roi.Width(), roi.Height(), integral);
+		}
+	}
 	
+	void BuildTable(float w, float h, const cv::Mat& integral);
 	virtual void UpdateFeatureVector(const Sample& s);
 	
 	void GenerateSystematic();
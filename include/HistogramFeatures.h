@@ -35,8 +35,19 @@ class Config;
 class HistogramFeatures : public Features
 {
 public:
+	static const int kNumBins = 16;
+	static const int kNumLevels = 4;
+	// level l is split into (l+1)x(l+1) cells
+	static const int kCount = kNumBins*(1+4+9+16);
+	
 	HistogramFeatures(const Config& conf);
 	
+	// feature d of sample i is written to out[d*stride+i]
+	void Fill(const MultiSample& s, double* out, int stride) const;
+	
+	// feature d of s is written to out[d*stride]
+	void Fill(const Sample& s, double* out, int stride) const;
+	
 private:
 	
 	virtual void UpdateFeatureVector(const Sample& s);
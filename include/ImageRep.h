@@ -32,6 +32,7 @@
 
 #include <opencv/cv.h>
 #include <vector>
+#include <cassert>
 
 #include <Eigen/Core>
 
@@ -40,10 +41,21 @@ class ImageRep
 public:
 	ImageRep(const cv::Mat& rImage, bool computeIntegral, bool computeIntegralHists, bool colour = false);
 	
-	int Sum(const IntRect& rRect, int channel = 0) const;
+	inline int Sum(const IntRect& rRect, int channel = 0) const
+	{
+		assert(rRect.XMin() >= 0 && rRect.YMin() >= 0 && rRect.XMax() <= m_images[0].cols && rRect.YMax() <= m_images[0].rows);
+		const cv::Mat& ii = m_integralImages[channel];
+		return ii.at<int>(rRect.YMin(), rRect.XMin()) +
+				ii.at<int>(rRect.YMax(), rRect.XMax()) -
+				ii.at<int>(rRect.YMax(), rRect.XMin()) -
+				ii.at<int>(rRect.YMin(), rRect.XMax());//ؾοڵغ
+	}
 	void Hist(const IntRect& rRect, Eigen::VectorXd& h) const;
+	// bin i is written to h[i*stride]
+	void Hist(const IntRect& rRect, double* h, int stride) const;
 	
 	inline const cv::Mat& GetImage(int channel = 0) const { return m_images[channel]; }
+	inline const cv::Mat& GetIntegralImage(int channel = 0) const { return m_integralImages[channel]; }
 	inline const IntRect& GetRect() const { return m_rect; }
 
 private:
@@ -0,0 +1,74 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef KERNEL_CACHE_H
+#define KERNEL_CACHE_H
+
+#include <vector>
+#include <cstddef>
+
+#if defined(STRUCK_FLOAT) || defined(STRUCK_FLOAT_KERNEL_CACHE)
+typedef float kernel_cache_t;
+#else
+typedef double kernel_cache_t;
+#endif
+
+// Symmetric matrix of kernel values between support vectors. Only the
+// lower triangle is stored, packed row by row, so the matrix can grow one
+// row at a time without moving any of the existing values.
+// Support vectors are given a slot which they keep for their lifetime,
+// freed slots are recycled so removing a support vector moves no data.
+class KernelCache
+{
+public:
+	KernelCache();
+	
+	void Reserve(int n);
+	int Add();
+	void Remove(int slot);
+	
+	// number of slots, including free ones
+	inline int Size() const { return m_n; }
+	
+	inline double operator()(int i, int j) const { return m_data[Index(i, j)]; }
+	inline void Set(int i, int j, double v) { m_data[Index(i, j)] = (kernel_cache_t)v; }
+	
+	size_t MemoryUsage() const;
+	
+private:
+	int m_n;
+	std::vector<kernel_cache_t> m_data;
+	std::vector<int> m_free;
+	
+	inline static size_t Index(int i, int j)
+	{
+		return (i >= j) ? (size_t)i*(i+1)/2 + j : (size_t)j*(j+1)/2 + i;
+	}
+};
+
+#endif
@@ -0,0 +1,64 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef KERNEL_MAP_FEATURES_H
+#define KERNEL_MAP_FEATURES_H
+
+#include "Features.h"
+#include "Config.h"
+
+#include <vector>
+
+// Explicit feature map for the additive intersection and chi2 kernels
+// (Vedaldi and Zisserman, "Efficient Additive Kernels via Explicit Feature
+// Maps", PAMI 2012). Each dimension is mapped to 2*order+1 values whose
+// inner product approximates the kernel, so the learner can use a linear
+// kernel on the mapped features.
+class KernelMapFeatures : public Features
+{
+public:
+	// takes ownership of features
+	KernelMapFeatures(Features* features, Config::KernelType kernel, int order);
+	~KernelMapFeatures();
+	
+	using Features::Eval;
+	virtual void Eval(const MultiSample& s, Eigen::MatrixXd& featMat);
+	
+private:
+	Features* m_features;
+	int m_order;
+	double m_step;
+	std::vector<double> m_coeffs;
+	std::vector<double> m_table;
+	
+	void Map(double v, double* out) const;
+	void MapExact(double v, double* out) const;
+	virtual void UpdateFeatureVector(const Sample& s);
+};
+
+#endif
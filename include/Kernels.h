@@ -29,68 +29,313 @@
 #define KERNELS_H
 
 #include <Eigen/Core>
+#include <Eigen/Array>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "MatrixView.h"
+#include "VectorExp.h"
+#include "VectorChi2.h"
+
+// one feature vector per row, used for blocks of support vectors
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXd;
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXf;
+
+// kernel blocks are evaluated on views, so that part of a matrix can be
+// passed without copying it out
+typedef MatrixView<double> ViewXd;
+typedef MatrixView<float> ViewXf;
+typedef MatrixView<double, Eigen::RowMajor> RowViewXd;
+typedef MatrixView<float, Eigen::RowMajor> RowViewXf;
+
+// precision of the feature vectors stored by the learner
+#ifdef STRUCK_FLOAT
+typedef float feature_t;
+#else
+typedef double feature_t;
+#endif
+typedef Eigen::Matrix<feature_t, Eigen::Dynamic, Eigen::Dynamic> FeatureMatrix;
+typedef Eigen::Matrix<feature_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowFeatureMatrix;
+typedef MatrixView<feature_t> FeatureView;
+typedef MatrixView<feature_t, Eigen::RowMajor> RowFeatureView;
+
+// K = X*S^T as a single cache friendly product, written straight into K.
+// lazyAssign as a map's operator= and += evaluate a product into a
+// temporary first.
+template <typename T>
+inline void ProductBlock(const MatrixView<T>& X, const MatrixView<T, Eigen::RowMajor>& S, const MatrixView<T>& K)
+{
+	typename MatrixView<T>::Map x = X.map();
+	typename MatrixView<T, Eigen::RowMajor>::Map s = S.map();
+	typename MatrixView<T>::Map k = K.map();
+	k.block(0, 0, K.rows(), K.cols()).lazyAssign(x.block(0, 0, X.rows(), X.cols())*s.block(0, 0, S.rows(), S.cols()).transpose());
+}
 
 class Kernel
 {
 public:
-	virtual double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const = 0;
-	virtual double Eval(const Eigen::VectorXd& x) const = 0;
+	virtual ~Kernel() {}
+	
+	// kernel value of a pair of feature vectors of length n
+	virtual double Eval(const double* x1, const double* x2, int n) const = 0;
+	virtual double Eval(const double* x, int n) const = 0;
+	
+	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	{
+		return Eval(x1.data(), x2.data(), x1.size());
+	}
+	
+	inline double Eval(const Eigen::VectorXd& x) const
+	{
+		return Eval(x.data(), x.size());
+	}
+	
+	// true if k(x1,x2) = <x1,x2>, the learner can then score with a
+	// single weight vector instead of the support vectors
+	virtual bool IsLinear() const { return false; }
+	
+	// true if k(x1,x2) = sum_d min(x1_d,x2_d), the learner can then score
+	// from the support vectors' values sorted per dimension
+	virtual bool IsIntersection() const { return false; }
+	
+	// values per row which a kernel block can be given precomputed, such
+	// as squared norms, so rows which are evaluated over and over only
+	// pay for them once. N has NormCount() columns, sized by the caller.
+	virtual int NormCount() const { return 0; }
+	virtual void Norms(const ViewXd& X, const ViewXd& N) const {}
+	virtual void Norms(const ViewXf& X, const ViewXd& N) const {}
+	
+	// kernel block K(i,j) = k(X.row(i), S.row(j)) for a block of candidates
+	// against a block of support vectors, with the norms of both from
+	// Norms(). K is sized by the caller.
+	virtual void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		PairBlock(X, S, K);
+	}
+	
+	// single precision version
+	virtual void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
+	{
+		PairBlock(X, S, K);
+	}
+
+private:
+	template <typename T>
+	void PairBlock(const MatrixView<T>& X, const MatrixView<T, Eigen::RowMajor>& S, const MatrixView<T>& K) const
+	{
+		// default implementation, a pair at a time with each candidate
+		// and support vector copied out in double precision once
+		RowMatrixXd s(S.rows(), S.cols());
+		for (int j = 0; j < S.rows(); ++j)
+		{
+			for (int d = 0; d < S.cols(); ++d)
+			{
+				s(j,d) = S(j,d);
+			}
+		}
+		Eigen::VectorXd x(X.cols());
+		for (int i = 0; i < X.rows(); ++i)
+		{
+			for (int d = 0; d < X.cols(); ++d)
+			{
+				x[d] = X(i,d);
+			}
+			for (int j = 0; j < S.rows(); ++j)
+			{
+				K(i,j) = (T)Eval(x.data(), s.data()+j*s.cols(), x.size());
+			}
+		}
+	}
 };
 
 class LinearKernel : public Kernel
 {
 public:
-	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	using Kernel::Eval;
+	
+	inline double Eval(const double* x1, const double* x2, int n) const
 	{
-		return x1.dot(x2);
+		return Eigen::VectorXd::Map(x1, n).dot(Eigen::VectorXd::Map(x2, n));
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x) const
+	inline double Eval(const double* x, int n) const
 	{
-		return x.squaredNorm();
+		return Eigen::VectorXd::Map(x, n).squaredNorm();
+	}
+	
+	bool IsLinear() const { return true; }
+	
+	void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		ProductBlock(X, S, K);
+	}
+	
+	void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
+	{
+		ProductBlock(X, S, K);
 	}
 };
 
 class GaussianKernel : public Kernel
 {
 public:
-	GaussianKernel(double sigma) : m_sigma(sigma) {}
-	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	using Kernel::Eval;
+	
+	// fastExp takes the exponentials with VectorExpFast, which is within
+	// kFastExpError of exp
+	GaussianKernel(double sigma, bool fastExp = false) : m_sigma(sigma), m_fastExp(fastExp) {}
+	inline double Eval(const double* x1, const double* x2, int n) const
 	{
-		return exp(-m_sigma*(x1-x2).squaredNorm());
+		double e = -m_sigma*(Eigen::VectorXd::Map(x1, n)-Eigen::VectorXd::Map(x2, n)).squaredNorm();
+		if (!m_fastExp) return exp(e);
+		VectorExpFast(&e, 1);
+		return e;
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x) const
+	inline double Eval(const double* x, int n) const
 	{
 		return 1.0;
 	}
+	
+	// squared norms
+	int NormCount() const { return 1; }
+	
+	void Norms(const ViewXd& X, const ViewXd& N) const
+	{
+		SquaredNorms(X, N);
+	}
+	
+	void Norms(const ViewXf& X, const ViewXd& N) const
+	{
+		SquaredNorms(X, N);
+	}
+	
+	void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		Block(X, Nx, S, Ns, K);
+	}
+	
+	void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
+	{
+		Block(X, Nx, S, Ns, K);
+	}
 
 private:
+	// exponentials are taken this many candidates at a time
+	static const int kExpChunk = 256;
+	
 	double m_sigma;
+	bool m_fastExp;
+	
+	template <typename T>
+	static void SquaredNorms(const MatrixView<T>& X, const ViewXd& N)
+	{
+		// a column of features at a time, which is contiguous
+		double* n = N.line(0);
+		std::fill(n, n+X.rows(), 0.0);
+		for (int d = 0; d < X.cols(); ++d)
+		{
+			const T* x = X.line(d);
+			for (int i = 0; i < X.rows(); ++i)
+			{
+				n[i] += (double)x[i]*x[i];
+			}
+		}
+	}
+	
+	template <typename T>
+	void Block(const MatrixView<T>& X, const ViewXd& Nx, const MatrixView<T, Eigen::RowMajor>& S, const ViewXd& Ns,
+		const MatrixView<T>& K) const
+	{
+		// ||x-s||^2 = ||x||^2 + ||s||^2 - 2<x,s>, so the bulk of the work
+		// is a single dense matrix product, the exponentials are then
+		// taken a column at a time with the vector exp
+		ProductBlock(X, S, K);
+		double e[kExpChunk];
+		const double* nx = Nx.line(0);
+		for (int j = 0; j < K.cols(); ++j)
+		{
+			T* k = K.line(j);
+			double ns = Ns(j,0);
+			for (int start = 0; start < K.rows(); start += kExpChunk)
+			{
+				int n = std::min((int)kExpChunk, K.rows()-start);
+				for (int i = 0; i < n; ++i)
+				{
+					e[i] = -m_sigma*std::max((nx[start+i]+ns) - 2.0*k[start+i], 0.0);
+				}
+				if (m_fastExp) VectorExpFast(e, n);
+				else VectorExp(e, n);
+				for (int i = 0; i < n; ++i)
+				{
+					k[start+i] = (T)e[i];
+				}
+			}
+		}
+	}
 };
 
 class IntersectionKernel : public Kernel
 {
 public:
-	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	using Kernel::Eval;
+	
+	inline double Eval(const double* x1, const double* x2, int n) const
 	{
-		return x1.cwise().min(x2).sum();
+		return Eigen::VectorXd::Map(x1, n).cwise().min(Eigen::VectorXd::Map(x2, n)).sum();
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x) const
+	inline double Eval(const double* x, int n) const
+	{
+		return Eigen::VectorXd::Map(x, n).sum();
+	}
+	
+	bool IsIntersection() const { return true; }
+	
+	void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		Block(X, S, K);
+	}
+	
+	void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
 	{
-		return x.sum();
+		Block(X, S, K);
+	}
+
+private:
+	template <typename T>
+	static void Block(const MatrixView<T>& X, const MatrixView<T, Eigen::RowMajor>& S, const MatrixView<T>& K)
+	{
+		// each feature of a support vector is compared against a whole
+		// column of candidates at once, which is contiguous and vectorises
+		for (int j = 0; j < S.rows(); ++j)
+		{
+			T* k = K.line(j);
+			const T* s = S.line(j);
+			std::fill(k, k+X.rows(), T(0));
+			for (int d = 0; d < X.cols(); ++d)
+			{
+				const T* x = X.line(d);
+				T sd = s[d];
+				for (int i = 0; i < X.rows(); ++i)
+				{
+					k[i] += std::min(x[i], sd);
+				}
+			}
+		}
 	}
 };
 
 class Chi2Kernel : public Kernel
 {
 public:
-	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	using Kernel::Eval;
+	
+	inline double Eval(const double* x1, const double* x2, int n) const
 	{
 		double result = 0.0;
-		for (int i = 0; i < x1.size(); ++i)
+		for (int i = 0; i < n; ++i)
 		{
 			double a = x1[i];
 			double b = x2[i];
@@ -99,15 +344,38 @@ public:
 		return 1.0 - result;
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x) const
+	inline double Eval(const double* x, int n) const
 	{
 		return 1.0;
 	}
+	
+	void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		Block(X, S, K);
+	}
+	
+	void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
+	{
+		Block(X, S, K);
+	}
+
+private:
+	template <typename T>
+	static void Block(const MatrixView<T>& X, const MatrixView<T, Eigen::RowMajor>& S, const MatrixView<T>& K)
+	{
+		// a column of candidates against each support vector at a time
+		for (int j = 0; j < S.rows(); ++j)
+		{
+			Chi2Column(X.data(), X.rows(), X.cols(), X.stride(), S.line(j), K.line(j));
+		}
+	}
 };
 
 class MultiKernel : public Kernel
 {
 public:
+	using Kernel::Eval;
+	
 	MultiKernel(const std::vector<Kernel*>& kernels, const std::vector<int>& featureCounts) :
 		m_n(kernels.size()),
 		m_norm(1.0/kernels.size()),
@@ -116,38 +384,138 @@ public:
 	{
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+	// each kernel is given its segment of the vectors in place
+	inline double Eval(const double* x1, const double* x2, int n) const
 	{
 		double sum = 0.0;
 		int start = 0;
 		for (int i = 0; i < m_n; ++i)
 		{
 			int c = m_counts[i];
-			sum += m_norm*m_kernels[i]->Eval(x1.segment(start, c), x2.segment(start, c));
+			sum += m_norm*m_kernels[i]->Eval(x1+start, x2+start, c);
 			start += c;
 		}
 		return sum;	
 	}
 	
-	inline double Eval(const Eigen::VectorXd& x) const
+	inline double Eval(const double* x, int n) const
 	{
 		double sum = 0.0;
 		int start = 0;
 		for (int i = 0; i < m_n; ++i)
 		{
 			int c = m_counts[i];
-			sum += m_norm*m_kernels[i]->Eval(x.segment(start, c));
+			sum += m_norm*m_kernels[i]->Eval(x+start, c);
 			start += c;
 		}
 		return sum;	
 	}
 	
+	// the norms of each kernel side by side
+	int NormCount() const
+	{
+		int count = 0;
+		for (int i = 0; i < m_n; ++i)
+		{
+			count += m_kernels[i]->NormCount();
+		}
+		return count;
+	}
+	
+	void Norms(const ViewXd& X, const ViewXd& N) const
+	{
+		BlockNorms(X, N);
+	}
+	
+	void Norms(const ViewXf& X, const ViewXd& N) const
+	{
+		BlockNorms(X, N);
+	}
+	
+	void EvalBlock(const ViewXd& X, const ViewXd& Nx, const RowViewXd& S, const ViewXd& Ns, const ViewXd& K) const
+	{
+		Block(X, Nx, S, Ns, K);
+	}
+	
+	void EvalBlock(const ViewXf& X, const ViewXd& Nx, const RowViewXf& S, const ViewXd& Ns, const ViewXf& K) const
+	{
+		Block(X, Nx, S, Ns, K);
+	}
+	
 private:
 	int m_n;
 	double m_norm;
 	std::vector<Kernel*> m_kernels;
 	std::vector<int> m_counts;	
 	
+	template <typename T>
+	void BlockNorms(const MatrixView<T>& X, const ViewXd& N) const
+	{
+		int start = 0;
+		int col = 0;
+		for (int i = 0; i < m_n; ++i)
+		{
+			int c = m_counts[i];
+			int nc = m_kernels[i]->NormCount();
+			if (nc > 0)
+			{
+				m_kernels[i]->Norms(X.block(0, start, X.rows(), c), N.block(0, col, X.rows(), nc));
+				col += nc;
+			}
+			start += c;
+		}
+	}
+	
+	template <typename T>
+	void Block(const MatrixView<T>& X, const ViewXd& Nx, const MatrixView<T, Eigen::RowMajor>& S, const ViewXd& Ns,
+		const MatrixView<T>& K) const
+	{
+		// the first kernel writes straight into K and the others into a
+		// scratch block which only ever grows, so nothing is allocated
+		// once it has seen the largest block. it is kept per thread as the
+		// tracker and the learner can evaluate blocks at the same time,
+		// which also means multi kernels can't be nested.
+		typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+		static thread_local Matrix scratch;
+		if (scratch.rows() < X.rows() || scratch.cols() < S.rows())
+		{
+			scratch.resize(std::max(X.rows(), (int)scratch.rows()), std::max(S.rows(), (int)scratch.cols()));
+		}
+		MatrixView<T> Ki = MatrixView<T>(scratch).block(0, 0, X.rows(), S.rows());
+		
+		T norm = (T)m_norm;
+		int start = 0;
+		int col = 0;
+		for (int i = 0; i < m_n; ++i)
+		{
+			int c = m_counts[i];
+			int nc = m_kernels[i]->NormCount();
+			const MatrixView<T>& out = (i == 0) ? K : Ki;
+			m_kernels[i]->EvalBlock(X.block(0, start, X.rows(), c), Nx.block(0, col, X.rows(), nc),
+				S.block(0, start, S.rows(), c), Ns.block(0, col, S.rows(), nc), out);
+			for (int j = 0; j < K.cols(); ++j)
+			{
+				T* k = K.line(j);
+				if (i == 0)
+				{
+					for (int r = 0; r < K.rows(); ++r)
+					{
+						k[r] *= norm;
+					}
+				}
+				else
+				{
+					const T* ki = Ki.line(j);
+					for (int r = 0; r < K.rows(); ++r)
+					{
+						k[r] += norm*ki[r];
+					}
+				}
+			}
+			start += c;
+			col += nc;
+		}
+	}
 };
 
 #endif
@@ -30,58 +30,129 @@
 
 #include "Rect.h"
 #include "Sample.h"
+#include "Kernels.h"
+#include "KernelCache.h"
 
 #include <vector>
+#include <memory>
 #include <Eigen/Core>
 
 #include <opencv/cv.h>
 
 class Config;
 class Features;
-class Kernel;
 
 class LaRank //סSolving multiclass support vector machine with LaRankʵstruck㷨Ҫ
 {
 public:
-	LaRank(const Config& conf, const Features& features, const Kernel& kernel);//ʼ ֵ 
+	LaRank(const Config& conf, const Features& features, const Kernel& kernel, const Features* evalFeatures = 0);//ʼ ֵ 
 	~LaRank();
 	
 	virtual void Eval(const MultiSample& x, std::vector<double>& results);
 	virtual void Update(const MultiSample& x, int y);
 	
 	virtual void Debug();
+	
+	// bytes held by the support patterns, support vectors and kernel matrix
+	size_t MemoryUsage() const;
+	
+	// microseconds taken by the last update
+	inline int GetUpdateTime() const { return m_updateTime; }
 
 private:
 
+	typedef Eigen::Matrix<kernel_cache_t, Eigen::Dynamic, Eigen::Dynamic> KernelMatrix;
+
 	struct SupportPattern
 	{
-		std::vector<Eigen::VectorXd> x;//ֵ
+		FeatureMatrix x;//ֵ, one row per label
+		Eigen::MatrixXd norms;//kernel norms of each row of x
 		std::vector<FloatRect> yv;//λõı仯ϵ
 		std::vector<cv::Mat> images;//ͼƬ
 		int y;//ֵ
-		int refCount;//Ҿͳsvĸ
+		std::vector<int> svs;//indices of the pattern's svs in m_svs
+		int ind;//position in m_sps
+		KernelMatrix k;//kernel value of each label against each sv
+		Eigen::VectorXd f;//current score of each label
+		std::vector<int> labels;//label held in each row of x, k and f
+		std::vector<int> rows;//row holding each label, -1 once compacted away
+		int time;//update in which the pattern was added
+		bool compacted;
 	};
 
-	struct SupportVector
+	// support vectors are kept as parallel arrays, with the feature vectors
+	// packed one per row, so the hot loops stream through memory
+	struct SupportVectors
+	{
+		RowFeatureMatrix features;
+		Eigen::MatrixXd norms;//kernel norms of the features
+		std::vector<SupportPattern*> x;
+		std::vector<int> y;//sprect
+		std::vector<double> b;//beta
+		std::vector<double> g;//gradient
+		std::vector<int> slot;//kernel cache slot
+		
+		inline int size() const { return (int)y.size(); }
+	};
+	
+	// what Eval needs of the model, a new one is published after each update
+	// so Eval can run on another thread while Update changes the svs
+	struct Model
+	{
+		RowFeatureMatrix features;
+		Eigen::MatrixXd norms;
+		Eigen::VectorXd b;
+		Eigen::VectorXd w;//weight vector, only for a linear kernel
+		// only for an intersection kernel, per dimension (column) the sv
+		// values in ascending order, with the sum of beta*s over the first
+		// k values and the sum of beta over the values from k on
+		Eigen::MatrixXd sorted;
+		Eigen::MatrixXd lowSum;
+		Eigen::MatrixXd highBeta;
+	};
+	
+	// scratch space for Eval, kept from frame to frame so that scoring
+	// allocates nothing once it has seen the largest frame. only Eval
+	// uses it, so an update running on another thread doesn't touch it.
+	struct EvalBuffers
+	{
+		Eigen::MatrixXd x;//features of the candidates
+		Eigen::VectorXd f;//their scores
+		FeatureMatrix tile;
+		Eigen::MatrixXd norms;
+		FeatureMatrix k;
+	};
+	
+	// the same for AddSupportVector, which runs on the update's side
+	struct UpdateBuffers
 	{
-		SupportPattern* x;
-		int y;//sprect
-		double b;//beta
-		double g;//gradient
-		cv::Mat image;
+		FeatureMatrix k;//kernel of a pattern's rows against the new sv
+		Eigen::VectorXd x;//the new sv in double, only with STRUCK_FLOAT
 	};
 	
 	const Config& m_config;
 	const Features& m_features;
 	const Kernel& m_kernel;
+	const Features& m_evalFeatures;
 	
 	std::vector<SupportPattern*> m_sps;
-	std::vector<SupportVector*> m_svs;
+	SupportVectors m_svs;
+	std::shared_ptr<const Model> m_model;
+	Eigen::VectorXd m_w;//sum of beta*x over the svs, only for a linear kernel
+	// the svs' values in each dimension in ascending order, with their
+	// kernel cache slots, only for an intersection kernel
+	std::vector<std::vector<std::pair<double, int> > > m_sorted;
+	EvalBuffers m_eval;
+	UpdateBuffers m_update;
 
 	cv::Mat m_debugImage;
 	
 	double m_C;
-	Eigen::MatrixXd m_K;
+	KernelCache m_K;
+	int m_budgetRemovals;
+	int m_updates;
+	double m_updateStart;
+	int m_updateTime;
 
 	inline double Loss(const FloatRect& y1, const FloatRect& y2) const
 	{
@@ -93,10 +164,19 @@ private:
 		//return dx*dx+dy*dy;
 	}
 	
+	inline double KernelValue(int i, int j) const
+	{
+		return m_K(m_svs.slot[i], m_svs.slot[j]);
+	}
+	
 	double ComputeDual() const;
 
 	void SMOStep(int ipos, int ineg);
-	std::pair<int, double> MinGradient(int ind);
+	std::pair<int, double> MinGradient(int ind) const;
+	double PatternViolation(int ind, bool svsOnly) const;
+	double MaxViolation() const;
+	int ChoosePattern(bool svsOnly) const;
+	bool OutOfTime() const;
 	void ProcessNew(int ind);
 	void Reprocess();
 	void ProcessOld();
@@ -107,10 +187,17 @@ private:
 	void RemoveSupportVectors(int ind1, int ind2);
 	void SwapSupportVectors(int ind1, int ind2);
 	
-	void BudgetMaintenance();
+	void BudgetMaintenance(int limit);
 	void BudgetMaintenanceRemove();
+	void RecomputeGradients();
+	
+	void InitialiseScores(SupportPattern* sp) const;
+	void AdjustScores(int ind, double db);
+	void CompactPattern(SupportPattern* sp);
 
-	double Evaluate(const Eigen::VectorXd& x, const FloatRect& y) const;
+	void Publish();
+	void BuildIntersectionTables(Model& model) const;
+	void Evaluate(const Model& model, const Eigen::MatrixXd& X, Eigen::VectorXd& f);
 	void UpdateDebugImage();
 };
 
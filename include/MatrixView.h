@@ -0,0 +1,99 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <Eigen/Core>
+
+// non-owning view of a block of a matrix: a pointer to its first element,
+// its size and the distance between the starts of its columns (of its rows
+// for a row major view). a sub-block is viewed in place, so code taking
+// views can be handed part of a matrix without it being copied out.
+template <typename T, int Options = Eigen::ColMajor>
+class MatrixView
+{
+public:
+	enum { IsRowMajor = (Options & Eigen::RowMajor) != 0 };
+	
+	// the matrix type viewed, with the options eigen's own typedefs give it
+	typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor | Eigen::AutoAlign> Matrix;
+	typedef Eigen::Map<Matrix> Map;
+	
+	MatrixView(const T* data, int rows, int cols, int stride) :
+		m_data(const_cast<T*>(data)),
+		m_rows(rows),
+		m_cols(cols),
+		m_stride(stride)
+	{
+	}
+	
+	MatrixView(const Matrix& m) :
+		m_data(const_cast<T*>(m.data())),
+		m_rows(m.rows()),
+		m_cols(m.cols()),
+		m_stride(IsRowMajor ? m.cols() : m.rows())
+	{
+	}
+	
+	inline int rows() const { return m_rows; }
+	inline int cols() const { return m_cols; }
+	inline int stride() const { return m_stride; }
+	inline T* data() const { return m_data; }
+	
+	inline T& operator()(int i, int j) const
+	{
+		return IsRowMajor ? m_data[i*m_stride+j] : m_data[j*m_stride+i];
+	}
+	
+	// start of column j, or of row j for a row major view
+	inline T* line(int j) const { return m_data + j*m_stride; }
+	
+	inline MatrixView block(int row, int col, int rows, int cols) const
+	{
+		// the data may be null when the view is empty, so it's never
+		// dereferenced here, nor offset for an empty block
+		T* start = (rows > 0 && cols > 0) ? m_data + (IsRowMajor ? row*m_stride+col : col*m_stride+row) : m_data;
+		return MatrixView(start, rows, cols, m_stride);
+	}
+	
+	// the view padded out to its stride as an eigen map, the view itself
+	// is map.block(0, 0, rows(), cols()). only for a non-empty view.
+	inline Map map() const
+	{
+		return IsRowMajor ? Map(m_data, m_rows, m_stride) : Map(m_data, m_stride, m_cols);
+	}
+
+private:
+	T* m_data;
+	int m_rows;
+	int m_cols;
+	int m_stride;
+};
+
+#endif
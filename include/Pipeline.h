@@ -0,0 +1,137 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "Config.h"
+#include "Features.h"
+#include "Kernels.h"
+
+#include <Eigen/Core>
+#include <vector>
+
+// The features and kernel a tracker learns with. Create() picks a pipeline
+// with the feature and kernel types fixed at compile time for the common
+// single feature configs, and one put together at runtime for the rest.
+class Pipeline
+{
+public:
+	virtual ~Pipeline() {}
+	
+	static Pipeline* Create(const Config& conf);
+	
+	virtual Features& GetFeatures() = 0;
+	// separate features for scoring while the learner updates, else null
+	virtual Features* GetEvalFeatures() = 0;
+	virtual const Kernel& GetKernel() const = 0;
+	
+	inline bool NeedsIntegralImage() const { return m_needsIntegralImage; }
+	inline bool NeedsIntegralHist() const { return m_needsIntegralHist; }
+	
+protected:
+	Pipeline(const Config& conf);
+	
+private:
+	bool m_needsIntegralImage;
+	bool m_needsIntegralHist;
+};
+
+// Features of type F filled in a batch through F::Fill, which is bound
+// statically so each sample is written straight into its row with a
+// feature count known at compile time.
+template <typename F>
+class StaticFeatures : public F
+{
+public:
+	StaticFeatures(const Config& conf) : F(conf) {}
+	
+	using F::Eval;
+	virtual void Eval(const MultiSample& s, Eigen::MatrixXd& featMat)
+	{
+		int n = s.GetRects().size();
+		featMat.resize(n, F::kCount);
+		F::Fill(s, featMat.data(), n);
+	}
+};
+
+template <typename F, typename K>
+class StaticPipeline : public Pipeline
+{
+public:
+	StaticPipeline(const Config& conf, const K& kernel) :
+		Pipeline(conf),
+		m_features(conf),
+		m_evalFeatures(conf.asyncUpdate ? new StaticFeatures<F>(conf) : 0),
+		m_kernel(kernel)
+	{
+	}
+	
+	~StaticPipeline()
+	{
+		delete m_evalFeatures;
+	}
+	
+	Features& GetFeatures() { return m_features; }
+	Features* GetEvalFeatures() { return m_evalFeatures; }
+	const Kernel& GetKernel() const { return m_kernel; }
+	
+private:
+	StaticFeatures<F> m_features;
+	StaticFeatures<F>* m_evalFeatures;
+	K m_kernel;
+	
+	StaticPipeline(const StaticPipeline&);
+	StaticPipeline& operator=(const StaticPipeline&);
+};
+
+// Any config: several features, kernel maps, built from the virtual
+// feature and kernel classes.
+class DynamicPipeline : public Pipeline
+{
+public:
+	DynamicPipeline(const Config& conf);
+	~DynamicPipeline();
+	
+	Features& GetFeatures() { return *m_features.back(); }
+	Features* GetEvalFeatures() { return m_evalFeatures.empty() ? 0 : m_evalFeatures.back(); }
+	const Kernel& GetKernel() const { return *m_kernels.back(); }
+	
+private:
+	const Config& m_config;
+	std::vector<Features*> m_features;
+	std::vector<Features*> m_evalFeatures;
+	std::vector<Kernel*> m_kernels;
+	
+	void CreateFeatures(std::vector<Features*>& features);
+	
+	DynamicPipeline(const DynamicPipeline&);
+	DynamicPipeline& operator=(const DynamicPipeline&);
+};
+
+#endif
@@ -0,0 +1,59 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef RANDOM_FOURIER_FEATURES_H
+#define RANDOM_FOURIER_FEATURES_H
+
+#include "Features.h"
+
+#include <Eigen/Core>
+
+// Random Fourier features for the Gaussian kernel exp(-sigma*||x1-x2||^2)
+// (Rahimi and Recht, "Random Features for Large-Scale Kernel Machines",
+// NIPS 2007). The inner product of two mapped vectors approximates the
+// kernel, so the learner can use a linear kernel on the mapped features.
+class RandomFourierFeatures : public Features
+{
+public:
+	// takes ownership of features
+	RandomFourierFeatures(Features* features, double sigma, int dim, int seed);
+	~RandomFourierFeatures();
+	
+	using Features::Eval;
+	virtual void Eval(const MultiSample& s, Eigen::MatrixXd& featMat);
+	
+private:
+	Features* m_features;
+	Eigen::MatrixXd m_omega;//one random frequency per column
+	Eigen::VectorXd m_phase;
+	double m_scale;
+	
+	virtual void UpdateFeatureVector(const Sample& s);
+};
+
+#endif
@@ -37,8 +37,17 @@ class Config;
 class RawFeatures : public Features
 {
 public:
+	static const int kPatchSize = 16;
+	static const int kCount = kPatchSize*kPatchSize;
+	
 	RawFeatures(const Config& conf);
 	
+	// feature d of sample i is written to out[d*stride+i]
+	void Fill(const MultiSample& s, double* out, int stride);
+	
+	// feature d of s is written to out[d*stride]
+	void Fill(const Sample& s, double* out, int stride);
+	
 private:
 	cv::Mat m_patchImage;
 	
@@ -31,12 +31,12 @@
 #include "Rect.h"
 
 #include <vector>
+#include <future>
 #include <Eigen/Core>
 #include <opencv/cv.h>
 
 class Config;
-class Features;
-class Kernel;
+class Pipeline;
 class LaRank;
 class ImageRep;
 
@@ -57,15 +57,14 @@ public:
 private:
 	const Config& m_config;//constͲϳɿ캯ˣҲûкϳɿƺ=
 	bool m_initialised;
-	std::vector<Features*> m_features;
-	std::vector<Kernel*> m_kernels;
+	Pipeline* m_pipeline;
 	LaRank* m_pLearner;
+	std::future<void> m_pendingUpdate;
 	FloatRect m_bb;
 	cv::Mat m_debugImage;
-	bool m_needsIntegralImage;
-	bool m_needsIntegralHist;
 	
-	void UpdateLearner(const ImageRep& image);
+	void UpdateLearner(const ImageRep& image, FloatRect bb);
+	void WaitForLearner();
 	void UpdateDebugImage(const std::vector<FloatRect>& samples, const FloatRect& centre, const std::vector<double>& scores);
 };
 
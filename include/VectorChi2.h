@@ -0,0 +1,57 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef VECTOR_CHI2_H
+#define VECTOR_CHI2_H
+
+// chi2 kernel of every row of the column-major block x against s,
+// k[i] = 1 - sum_d (x(i,d)-s[d])^2/(0.5*(x(i,d)+s[d])+1e-8), where
+// column d of x starts at x+d*stride.
+// uses avx-512 or avx2 when the cpu has them, chosen once at runtime,
+// with the division done as a reciprocal estimate refined by newton
+// steps. otherwise falls back to plain division.
+void Chi2Column(const double* x, int rows, int cols, int stride, const double* s, double* k);
+void Chi2Column(const float* x, int rows, int cols, int stride, const float* s, float* k);
+
+// the implementations Chi2Column picks from. these are only needed to
+// check each one against the others on a cpu that can run several.
+enum Chi2Path
+{
+	kChi2Scalar,
+	kChi2Avx2,
+	kChi2Avx512
+};
+
+// whether this cpu can run path
+bool Chi2Supported(Chi2Path path);
+
+// Chi2Column forced onto path, which must be supported
+void Chi2Column(Chi2Path path, const double* x, int rows, int cols, int stride, const double* s, double* k);
+void Chi2Column(Chi2Path path, const float* x, int rows, int cols, int stride, const float* s, float* k);
+
+#endif
@@ -0,0 +1,43 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef VECTOR_EXP_H
+#define VECTOR_EXP_H
+
+// x[i] = exp(x[i]) for a whole array. uses avx-512 or avx2 when the cpu
+// has them, chosen once at runtime, and std::exp otherwise. the vector
+// versions agree with std::exp to within a couple of ulp.
+void VectorExp(double* x, int n);
+
+// a cheaper x[i] = exp(x[i]) with a relative error below kFastExpError,
+// about float precision, from half the polynomial terms. x[i] < -40 gives
+// exactly 0 (exp(-40) < 5e-18).
+static const double kFastExpError = 2e-7;
+void VectorExpFast(double* x, int n);
+
+#endif
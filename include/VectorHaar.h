@@ -0,0 +1,61 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#ifndef VECTOR_HAAR_H
+#define VECTOR_HAAR_H
+
+// haar features of n boxes one pixel apart along a row of an integral
+// image, the first with its top left corner at base. feature d adds up
+// weights[j]*(c[0]+c[1]-c[2]-c[3]) over its rects j = first[d] to
+// first[d+1]-1, where c are the integral image values at the four
+// offsets of rect j (offsets+4*j) from the box's corner, and divides by
+// norms[d]. feature d of box i is written to out[d*stride+i].
+// the boxes go down avx-512, avx2 or sse4.1 lanes, chosen once at
+// runtime, in the same single precision as the scalar code, so every
+// path gives the same result.
+void HaarRow(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride);
+
+// the implementations HaarRow picks from, so that each of them can be
+// checked against the scalar one on a cpu that runs several
+enum HaarPath
+{
+	kHaarScalar,
+	kHaarSse4,
+	kHaarAvx2,
+	kHaarAvx512
+};
+
+// whether this cpu can run path
+bool HaarSupported(HaarPath path);
+
+// HaarRow forced onto path, which must be supported
+void HaarRow(HaarPath path, const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride);
+
+#endif
@@ -65,6 +65,13 @@ Config::Config(const std::string& path)
 		else if (name == "searchRadius") iss >> searchRadius;
 		else if (name == "svmC") iss >> svmC;
 		else if (name == "svmBudgetSize") iss >> svmBudgetSize;
+		else if (name == "svmBudgetSlack") iss >> svmBudgetSlack;
+		else if (name == "svmCompactAge") iss >> svmCompactAge;
+		else if (name == "svmTolerance") iss >> svmTolerance;
+		else if (name == "svmMaxReprocess") iss >> svmMaxReprocess;
+		else if (name == "svmUpdateBudget") iss >> svmUpdateBudget;
+		else if (name == "asyncUpdate") iss >> asyncUpdate;
+		else if (name == "gaussianFastExp") iss >> gaussianFastExp;
 		else if (name == "feature")
 		{
 			string featureName, kernelName;
@@ -83,8 +90,12 @@ Config::Config(const std::string& path)
 			}
 			
 			if      (kernelName == KernelName(kKernelTypeLinear)) fkp.kernel = kKernelTypeLinear;
-			else if (kernelName == KernelName(kKernelTypeIntersection)) fkp.kernel = kKernelTypeIntersection;
-			else if (kernelName == KernelName(kKernelTypeChi2)) fkp.kernel = kKernelTypeChi2;
+			else if (kernelName == KernelName(kKernelTypeIntersection) || kernelName == KernelName(kKernelTypeChi2))
+			{
+				fkp.kernel = kernelName == KernelName(kKernelTypeChi2) ? kKernelTypeChi2 : kKernelTypeIntersection;
+				// optional order of the explicit feature map approximation
+				if (!iss.fail()) fkp.params.push_back(param);
+			}
 			else if (kernelName == KernelName(kKernelTypeGaussian))
 			{
 				if (iss.fail())
@@ -94,6 +105,8 @@ Config::Config(const std::string& path)
 				}
 				fkp.kernel = kKernelTypeGaussian;
 				fkp.params.push_back(param);
+				// optional number of random fourier features
+				if (iss >> param) fkp.params.push_back(param);
 			}
 			else
 			{
@@ -123,6 +136,13 @@ void Config::SetDefaults()
 	searchRadius = 30;
 	svmC = 1.0;
 	svmBudgetSize = 0;
+	svmBudgetSlack = 0;
+	svmCompactAge = 0;
+	svmTolerance = 0.0;
+	svmMaxReprocess = 10;
+	svmUpdateBudget = 0;
+	asyncUpdate = false;
+	gaussianFastExp = false;
 	
 	features.clear();
 }
@@ -173,6 +193,13 @@ ostream& operator<< (ostream& out, const Config& conf)
 	out << "  searchRadius       = " << conf.searchRadius << endl;
 	out << "  svmC               = " << conf.svmC << endl;
 	out << "  svmBudgetSize      = " << conf.svmBudgetSize << endl;
+	out << "  svmBudgetSlack     = " << conf.svmBudgetSlack << endl;
+	out << "  svmCompactAge      = " << conf.svmCompactAge << endl;
+	out << "  svmTolerance       = " << conf.svmTolerance << endl;
+	out << "  svmMaxReprocess    = " << conf.svmMaxReprocess << endl;
+	out << "  svmUpdateBudget    = " << conf.svmUpdateBudget << endl;
+	out << "  asyncUpdate        = " << conf.asyncUpdate << endl;
+	out << "  gaussianFastExp    = " << conf.gaussianFastExp << endl;
 	
 	for (int i = 0; i < (int)conf.features.size(); ++i)
 	{
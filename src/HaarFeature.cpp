@@ -109,17 +109,35 @@ HaarFeature::~HaarFeature()
 {
 }
 
-float HaarFeature::Eval(const Sample& s) const
+// Eval rounds the corner pos+a of a box at pos, which is pos plus the
+// rounding of a unless a is close enough to a half for pos+a to lose it
+static bool RoundOffset(float a, int size, int& offset)
 {
-	const ImageRep& image = s.GetImage();
-	const FloatRect& roi = s.GetROI();
-	float value = 0.f;
+	offset = (int)(a+0.5f);
+	for (int pos = 1; pos < size; ++pos)
+	{
+		if ((int)((float)pos+a+0.5f) != pos+offset) return false;
+	}
+	return true;
+}
+
+bool HaarFeature::GetOffsets(float w, float h, int step, int cols, int rows, int* offsets, float* weights, float& norm) const
+{
+	bool exact = true;
 	for (int i = 0; i < (int)m_rects.size(); ++i)
 	{
 		const FloatRect& r = m_rects[i];
-		IntRect sampleRect((int)(roi.XMin()+r.XMin()*roi.Width()+0.5f), (int)(roi.YMin()+r.YMin()*roi.Height()+0.5f),
-			(int)(r.Width()*roi.Width()), (int)(r.Height()*roi.Height()));
-		value += m_weights[i]*image.Sum(sampleRect);
+		int x0, y0;
+		if (!RoundOffset(r.XMin()*w, cols, x0)) exact = false;
+		if (!RoundOffset(r.YMin()*h, rows, y0)) exact = false;
+		int x1 = x0+(int)(r.Width()*w);
+		int y1 = y0+(int)(r.Height()*h);
+		offsets[4*i] = y0*step+x0;
+		offsets[4*i+1] = y1*step+x1;
+		offsets[4*i+2] = y1*step+x0;
+		offsets[4*i+3] = y0*step+x1;
+		weights[i] = m_weights[i];
 	}
-	return value / (m_factor*roi.Area()*m_bb.Area());
-}
\ No newline at end of file
+	norm = m_factor*(w*h)*m_bb.Area();
+	return exact;
+}
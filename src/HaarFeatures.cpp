@@ -27,12 +27,11 @@
 
 #include "HaarFeatures.h"
 #include "Config.h"
-
-static const int kSystematicFeatureCount = 192;
+#include "VectorHaar.h"
 
 HaarFeatures::HaarFeatures(const Config& conf)
 {
-	SetCount(kSystematicFeatureCount);
+	SetCount(kCount);
 	GenerateSystematic();
 }
 
@@ -59,8 +58,79 @@ void HaarFeatures::GenerateSystematic()
 
 void HaarFeatures::UpdateFeatureVector(const Sample& s)
 {
-	for (int i = 0; i < m_featureCount; ++i)
+	Fill(s, m_featVec.data(), 1);
+}
+
+void HaarFeatures::Eval(const MultiSample& s, Eigen::MatrixXd& featMat)
+{
+	featMat.resize(s.GetRects().size(), kCount);
+	Fill(s, featMat.data(), featMat.rows());
+}
+
+void HaarFeatures::Fill(const MultiSample& s, double* out, int stride)
+{
+	const std::vector<FloatRect>& rects = s.GetRects();
+	const cv::Mat& integral = s.GetImage().GetIntegralImage();
+	int n = rects.size();
+	int i = 0;
+	while (i < n)
+	{
+		const FloatRect& r = rects[i];
+		int x = (int)r.XMin();
+		int y = (int)r.YMin();
+		if ((float)x != r.XMin() || (float)y != r.YMin())
+		{
+			Fill(s.GetSample(i), out+i, stride);
+			++i;
+			continue;
+		}
+		
+		// the run of boxes each one pixel right of the last
+		int len = 1;
+		while (i+len < n && rects[i+len].XMin() == r.XMin()+len && rects[i+len].YMin() == r.YMin() &&
+			rects[i+len].Width() == r.Width() && rects[i+len].Height() == r.Height())
+		{
+			++len;
+		}
+		
+		UseTable(r, integral);
+		HaarRow(integral.ptr<int>(y)+x, len, &m_table.first[0], &m_table.offsets[0], &m_table.weights[0],
+			&m_table.norms[0], kCount, out+i, stride);
+		for (int d = 0; d < kCount; ++d)
+		{
+			if (m_table.exact[d]) continue;
+			for (int k = i; k < i+len; ++k)
+			{
+				out[d*stride+k] = m_features[d].Eval(s.GetSample(k));
+			}
+		}
+		i += len;
+	}
+}
+void HaarFeatures::BuildTable(float w, float h, const cv::Mat& integral)
+{
+	m_table.width = w;
+	m_table.height = h;
+	m_table.cols = integral.cols;
+	m_table.rows = integral.rows;
+	m_table.step = integral.step1();
+	
+	m_table.first.resize(kCount+1);
+	m_table.first[0] = 0;
+	for (int i = 0; i < kCount; ++i)
+	{
+		m_table.first[i+1] = m_table.first[i]+m_features[i].GetRectCount();
+	}
+	int rects = m_table.first[kCount];
+	m_table.offsets.resize(4*rects);
+	m_table.weights.resize(rects);
+	m_table.norms.resize(kCount);
+	m_table.exact.resize(kCount);
+	
+	for (int i = 0; i < kCount; ++i)
 	{
-		m_featVec[i] = m_features[i].Eval(s);
+		int j = m_table.first[i];
+		m_table.exact[i] = m_features[i].GetOffsets(w, h, m_table.step, m_table.cols, m_table.rows,
+			&m_table.offsets[4*j], &m_table.weights[j], m_table.norms[i]);
 	}
 }
@@ -31,13 +31,12 @@
 #include "Rect.h"
 
 #include <iostream>
+#include <cassert>
 
 using namespace Eigen;
 using namespace cv;
 using namespace std;
 
-static const int kNumBins = 16;
-static const int kNumLevels = 4;
 static const int kNumCellsX = 3;
 static const int kNumCellsY = 3;
 
@@ -49,19 +48,31 @@ HistogramFeatures::HistogramFeatures(const Config& conf)
 		//nc += 1 << 2*i;
 		nc += (i+1)*(i+1);
 	}
-	SetCount(kNumBins*nc);
+	assert(kNumBins*nc == kCount);
+	SetCount(kCount);
 	cout << "histogram bins: " << GetCount() << endl;
 }
 
 void HistogramFeatures::UpdateFeatureVector(const Sample& s)
+{
+	Fill(s, m_featVec.data(), 1);
+}
+
+void HistogramFeatures::Fill(const MultiSample& s, double* out, int stride) const
+{
+	for (int i = 0; i < (int)s.GetRects().size(); ++i)
+	{
+		Fill(s.GetSample(i), out+i, stride);
+	}
+}
+
+void HistogramFeatures::Fill(const Sample& s, double* out, int stride) const
 {
 	IntRect rect = s.GetROI(); // note this truncates to integers
 	//cv::Rect roi(rect.XMin(), rect.YMin(), rect.Width(), rect.Height());
 	//cv::resize(s.GetImage().GetImage(0)(roi), m_patchImage, m_patchImage.size());
 	
-	m_featVec.setZero();
-	VectorXd hist(kNumBins);
-	
+	// every cell is written, so nothing needs clearing
 	int histind = 0;
 	for (int il = 0; il < kNumLevels; ++il)
 	{
@@ -75,11 +86,14 @@ void HistogramFeatures::UpdateFeatureVector(const Sample& s)
 			for (int ix = 0; ix < nc; ++ix)
 			{
 				cell.SetXMin(s.GetROI().XMin()+ix*w);
-				s.GetImage().Hist(cell, hist);
-				m_featVec.segment(histind*kNumBins, kNumBins) = hist;
+				s.GetImage().Hist(cell, out + histind*kNumBins*stride, stride);
 				++histind;
 			}
 		}
 	}
-	m_featVec /= histind;
+	double scale = 1.0/histind;
+	for (int d = 0; d < kCount; ++d)
+	{
+		out[d*stride] *= scale;
+	}
 }
@@ -106,17 +106,12 @@ ImageRep::ImageRep(const Mat& image, bool computeIntegral, bool computeIntegralH
 	}
 }
 
-int ImageRep::Sum(const IntRect& rRect, int channel) const
+void ImageRep::Hist(const IntRect& rRect, Eigen::VectorXd& h) const
 {
-	//ʹassert飬Ǻܺõϰߣֵѧϰ
-	assert(rRect.XMin() >= 0 && rRect.YMin() >= 0 && rRect.XMax() <= m_images[0].cols && rRect.YMax() <= m_images[0].rows);
-	return m_integralImages[channel].at<int>(rRect.YMin(), rRect.XMin()) +
-			m_integralImages[channel].at<int>(rRect.YMax(), rRect.XMax()) -
-			m_integralImages[channel].at<int>(rRect.YMax(), rRect.XMin()) -
-			m_integralImages[channel].at<int>(rRect.YMin(), rRect.XMax());//ؾοڵغ
+	Hist(rRect, h.data(), 1);
 }
 
-void ImageRep::Hist(const IntRect& rRect, Eigen::VectorXd& h) const
+void ImageRep::Hist(const IntRect& rRect, double* h, int stride) const
 {
 	assert(rRect.XMin() >= 0 && rRect.YMin() >= 0 && rRect.XMax() <= m_images[0].cols && rRect.YMax() <= m_images[0].rows);
 	int norm = rRect.Area();
@@ -126,6 +121,6 @@ void ImageRep::Hist(const IntRect& rRect, Eigen::VectorXd& h) const
 			m_integralHistImages[i].at<int>(rRect.YMax(), rRect.XMax()) -
 			m_integralHistImages[i].at<int>(rRect.YMax(), rRect.XMin()) -
 			m_integralHistImages[i].at<int>(rRect.YMin(), rRect.XMax());
-		h[i] = (float)sum/norm;
+		h[i*stride] = (float)sum/norm;
 	}
 }
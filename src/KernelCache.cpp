@@ -0,0 +1,65 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "KernelCache.h"
+
+using namespace std;
+
+KernelCache::KernelCache() :
+	m_n(0)
+{
+}
+
+void KernelCache::Reserve(int n)
+{
+	m_data.reserve((size_t)n*(n+1)/2);
+}
+
+int KernelCache::Add()
+{
+	if (!m_free.empty())
+	{
+		int slot = m_free.back();
+		m_free.pop_back();
+		return slot;
+	}
+	// append a row, existing values stay put
+	++m_n;
+	m_data.resize((size_t)m_n*(m_n+1)/2);
+	return m_n-1;
+}
+
+void KernelCache::Remove(int slot)
+{
+	m_free.push_back(slot);
+}
+
+size_t KernelCache::MemoryUsage() const
+{
+	return sizeof(kernel_cache_t)*m_data.capacity() + sizeof(int)*m_free.capacity();
+}
@@ -0,0 +1,175 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "KernelMapFeatures.h"
+
+#include <cmath>
+#include <cassert>
+
+using namespace Eigen;
+using namespace std;
+
+// the map is tabulated over this range of binary exponents, with the
+// mantissa split into kTableSubdivisions intervals and interpolated
+static const int kTableMinExponent = -24;
+static const int kTableMaxExponent = 8;
+static const int kTableSubdivisions = 128;
+
+KernelMapFeatures::KernelMapFeatures(Features* features, Config::KernelType kernel, int order) :
+	m_features(features),
+	m_order(order)
+{
+	assert(kernel == Config::kKernelTypeIntersection || kernel == Config::kKernelTypeChi2);
+	
+	// both kernels are homogeneous, k(a,b) = sqrt(ab)*K(log(b/a)), and the map
+	// samples the spectrum of K at multiples of m_step. the periods are the
+	// ones recommended in the paper for a uniform window.
+	double period;
+	double scale;
+	if (kernel == Config::kKernelTypeIntersection)
+	{
+		period = 2.38*log(order+0.8)+5.6;
+		scale = 1.0;
+	}
+	else
+	{
+		// Chi2Kernel is 1-sum (a-b)^2/((a+b)/2) = 1-2*sum(a+b)+4*sum 2ab/(a+b),
+		// the terms which only depend on one argument cancel in the learner
+		// since the betas of each support pattern sum to zero, so only the
+		// scaled homogeneous chi2 kernel 2ab/(a+b) needs mapping
+		period = 5.86*sqrt((double)order)+3.65;
+		scale = 2.0;
+	}
+	m_step = 2.0*M_PI/period;
+	
+	for (int j = 0; j <= order; ++j)
+	{
+		double lambda = j*m_step;
+		double kappa;
+		if (kernel == Config::kKernelTypeIntersection)
+		{
+			kappa = 2.0/(M_PI*(1.0+4.0*lambda*lambda));
+		}
+		else
+		{
+			kappa = 1.0/cosh(M_PI*lambda);
+		}
+		m_coeffs.push_back(scale*sqrt((j == 0 ? 1.0 : 2.0)*m_step*kappa));
+	}
+	
+	int n = 2*order+1;
+	m_table.resize((kTableMaxExponent-kTableMinExponent+1)*(kTableSubdivisions+1)*n);
+	double* p = &m_table[0];
+	for (int e = kTableMinExponent; e <= kTableMaxExponent; ++e)
+	{
+		for (int k = 0; k <= kTableSubdivisions; ++k, p += n)
+		{
+			MapExact(ldexp(0.5*(1.0+(double)k/kTableSubdivisions), e), p);
+		}
+	}
+	
+	SetCount(n*features->GetCount());
+}
+
+KernelMapFeatures::~KernelMapFeatures()
+{
+	delete m_features;
+}
+
+void KernelMapFeatures::MapExact(double v, double* out) const
+{
+	double sv = sqrt(v);
+	double lv = log(v);
+	out[0] = m_coeffs[0]*sv;
+	for (int j = 1; j <= m_order; ++j)
+	{
+		out[2*j-1] = m_coeffs[j]*sv*cos(j*m_step*lv);
+		out[2*j] = m_coeffs[j]*sv*sin(j*m_step*lv);
+	}
+}
+
+void KernelMapFeatures::Map(double v, double* out) const
+{
+	int n = 2*m_order+1;
+	if (v <= 0.0)
+	{
+		for (int j = 0; j < n; ++j) out[j] = 0.0;
+		return;
+	}
+	
+	// v = m*2^e with m in [0.5,1)
+	int e;
+	double m = frexp(v, &e);
+	if (e < kTableMinExponent || e > kTableMaxExponent)
+	{
+		MapExact(v, out);
+		return;
+	}
+	
+	double t = (2.0*m-1.0)*kTableSubdivisions;
+	int k = (int)t;
+	t -= k;
+	const double* p1 = &m_table[((e-kTableMinExponent)*(kTableSubdivisions+1)+k)*n];
+	const double* p2 = p1+n;
+	for (int j = 0; j < n; ++j)
+	{
+		out[j] = p1[j] + t*(p2[j]-p1[j]);
+	}
+}
+
+void KernelMapFeatures::Eval(const MultiSample& s, MatrixXd& featMat)
+{
+	MatrixXd x;
+	m_features->Eval(s, x);
+	
+	// map one input column at a time so the writes run down the columns
+	int n = 2*m_order+1;
+	featMat.resize(x.rows(), GetCount());
+	vector<double> out(n);
+	for (int i = 0; i < x.cols(); ++i)
+	{
+		for (int r = 0; r < x.rows(); ++r)
+		{
+			Map(x(r,i), &out[0]);
+			for (int j = 0; j < n; ++j)
+			{
+				featMat(r, i*n+j) = out[j];
+			}
+		}
+	}
+}
+
+void KernelMapFeatures::UpdateFeatureVector(const Sample& s)
+{
+	const VectorXd& x = m_features->Eval(s);
+	int n = 2*m_order+1;
+	for (int i = 0; i < x.size(); ++i)
+	{
+		Map(x[i], &m_featVec[i*n]);
+	}
+}
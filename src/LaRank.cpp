@@ -36,6 +36,8 @@
 
 #include <Eigen/Array>
 
+#include <algorithm>
+
 #include <opencv/highgui.h>
 static const int kTileSize = 30;
 using namespace cv;
@@ -43,54 +45,150 @@ using namespace cv;
 using namespace std;
 using namespace Eigen;
 
-static const int kMaxSVs = 2000; // TODO (only used when no budget)
+static const int kInitialSVCapacity = 16; // sv store size when there is no budget
+static const int kEvalTileSize = 128; // candidates per kernel block in Eval
+static const int kGradientResyncInterval = 50; // budget removals between exact gradient updates
+static const int kScoreColumnSlack = 16; // spare sv columns allocated in a pattern's kernel cache
 
 
-LaRank::LaRank(const Config& conf, const Features& features, const Kernel& kernel) :
+LaRank::LaRank(const Config& conf, const Features& features, const Kernel& kernel, const Features* evalFeatures) :
 	m_config(conf),
 	m_features(features),
 	m_kernel(kernel),
-	m_C(conf.svmC)
+	m_evalFeatures(evalFeatures ? *evalFeatures : features),
+	m_C(conf.svmC),
+	m_budgetRemovals(0),
+	m_updates(0),
+	m_updateStart(0.0),
+	m_updateTime(0)
 {
-	int N = conf.svmBudgetSize > 0 ? conf.svmBudgetSize+2 : kMaxSVs;
-	m_K = MatrixXd::Zero(N, N);
+	int N = conf.svmBudgetSize > 0 ? conf.svmBudgetSize+conf.svmBudgetSlack+2 : kInitialSVCapacity;
+	m_K.Reserve(N);
+	m_svs.features.resize(N, features.GetCount());
+	m_svs.norms.resize(N, kernel.NormCount());
+	if (kernel.IsLinear())
+	{
+		m_w = VectorXd::Zero(features.GetCount());
+	}
+	if (kernel.IsIntersection())
+	{
+		m_sorted.resize(features.GetCount());
+	}
+	Publish();
 	m_debugImage = Mat(800, 600, CV_8UC3);
 }
 
 LaRank::~LaRank()
 {
+	for (int i = 0; i < (int)m_sps.size(); ++i)
+	{
+		delete m_sps[i];
+	}
 }
 
-double LaRank::Evaluate(const Eigen::VectorXd& x, const FloatRect& y) const//йʽ10벿ּ㣬f=S(x,y)
+// grows m to at least rows x cols, its contents are lost if it grows
+template <typename Matrix>
+static void Reserve(Matrix& m, int rows, int cols)
 {
-	double f = 0.0;
-	for (int i = 0; i < (int)m_svs.size(); ++i)
+	if (m.rows() < rows || m.cols() < cols)
 	{
-		const SupportVector& sv = *m_svs[i];//ÿһ֧
-		f += sv.b*m_kernel.Eval(x, sv.x->x[sv.y]);//beta*˹,Ȼۼӣõscore
+		m.resize(max(rows, (int)m.rows()), max(cols, (int)m.cols()));
 	}
-	return f;
 }
 
-void LaRank::Eval(const MultiSample& sample, std::vector<double>& results)
+void LaRank::Evaluate(const Model& model, const Eigen::MatrixXd& X, Eigen::VectorXd& f)
 {
-	const FloatRect& centre(sample.GetRects()[0]);//һ֡Ŀľ
-	vector<VectorXd> fvs;
-	//const_castǿתȥԣm_featuresǿԱ༭
-	//Featuresص
-	const_cast<Features&>(m_features).Eval(sample, fvs);//fvs haarֵ
-	results.resize(fvs.size());//vectorĴСsamplerectĸһ
-	for (int i = 0; i < (int)fvs.size(); ++i)
-	{
-		// express y in coord frame of centre sample
-		FloatRect y(sample.GetRects()[i]);
-		y.Translate(-centre.XMin(), -centre.YMin());//ÿrectĺȥһ֡ĺ
-		results[i] = Evaluate(fvs[i], y);//EvaluateFÿrectxyӦķscore
+	int n = X.rows();
+	f.resize(n);
+	if (model.w.size() > 0)
+	{
+		// linear kernel, one dot product per candidate
+		f.lazyAssign(X*model.w);
+		return;
+	}
+	
+	f.setZero();
+	if (model.sorted.size() > 0)
+	{
+		// intersection kernel, sum_j b_j*min(x,s_j) in each dimension is
+		// the sum of b_j*s_j below x plus x times the sum of b_j above it,
+		// so one binary search per dimension replaces the sv loop
+		int m = model.sorted.rows();
+		int top = 1;
+		while (2*top <= m) top *= 2;
+		for (int d = 0; d < X.cols(); ++d)
+		{
+			const double* v = model.sorted.data() + d*m;
+			const double* low = model.lowSum.data() + d*(m+1);
+			const double* high = model.highBeta.data() + d*(m+1);
+			for (int i = 0; i < n; ++i)
+			{
+				// k = number of values <= x, found without branches
+				double x = X(i, d);
+				int k = 0;
+				for (int step = top; step > 0; step /= 2)
+				{
+					k = (k+step <= m && v[k+step-1] <= x) ? k+step : k;
+				}
+				f[i] += low[k] + x*high[k];
+			}
+		}
+		return;
+	}
+	if (model.b.size() == 0) return;
+	
+	// score a tile of rows at a time so that the kernel block stays
+	// in cache, the kernel does the whole tile in one pass. the tiles
+	// are views of buffers kept from frame to frame
+	int m = model.b.size();
+	int tile = min(kEvalTileSize, n);
+	Reserve(m_eval.tile, tile, X.cols());
+	Reserve(m_eval.norms, tile, m_kernel.NormCount());
+	Reserve(m_eval.k, tile, m);
+	for (int start = 0; start < n; start += kEvalTileSize)
+	{
+		int rows = min(kEvalTileSize, n-start);
+		FeatureView Xt = FeatureView(m_eval.tile).block(0, 0, rows, X.cols());
+		ViewXd norms = ViewXd(m_eval.norms).block(0, 0, rows, m_kernel.NormCount());
+		FeatureView K = FeatureView(m_eval.k).block(0, 0, rows, m);
+		for (int d = 0; d < X.cols(); ++d)
+		{
+			const double* x = X.data() + d*n + start;
+			feature_t* xt = Xt.line(d);
+			for (int i = 0; i < rows; ++i)
+			{
+				xt[i] = (feature_t)x[i];
+			}
+		}
+		m_kernel.Norms(Xt, norms);
+		m_kernel.EvalBlock(Xt, norms, model.features, model.norms, K);
+		for (int j = 0; j < m; ++j)
+		{
+			const feature_t* k = K.line(j);
+			double b = model.b[j];
+			for (int i = 0; i < rows; ++i)
+			{
+				f[start+i] += b*k[i];
+			}
+		}
 	}
 }
 
+void LaRank::Eval(const MultiSample& sample, std::vector<double>& results)
+{
+	// take the newest published model, an update may be running
+	shared_ptr<const Model> model = atomic_load(&m_model);
+	
+	const_cast<Features&>(m_evalFeatures).Eval(sample, m_eval.x);
+	Evaluate(*model, m_eval.x, m_eval.f);
+	results.resize(m_eval.f.size());
+	VectorXd::Map(&results[0], m_eval.f.size()) = m_eval.f;
+}
+
 void LaRank::Update(const MultiSample& sample, int y)
 {
+	m_updateStart = (double)getTickCount();
+	
 	// add new support pattern
 	SupportPattern* sp = new SupportPattern;//һsp
 	const vector<FloatRect>& rects = sample.GetRects();//е
@@ -112,38 +210,133 @@ void LaRank::Update(const MultiSample& sample, int y)
 		}
 	}
 	// evaluate features for each sample
-	sp->x.resize(rects.size());
-	const_cast<Features&>(m_features).Eval(sample, sp->x);//ȡ洢sp
+	MatrixXd X;
+	const_cast<Features&>(m_features).Eval(sample, X);//ȡ洢sp
+	sp->x = X.cast<feature_t>();
+	sp->norms.resize(sp->x.rows(), m_kernel.NormCount());
+	m_kernel.Norms(sp->x, sp->norms);
 	sp->y = y;
-	sp->refCount = 0;
+	sp->ind = (int)m_sps.size();
+	sp->time = m_updates++;
+	sp->compacted = false;
+	for (int i = 0; i < (int)rects.size(); ++i)
+	{
+		sp->labels.push_back(i);
+		sp->rows.push_back(i);
+	}
+	InitialiseScores(sp);
 	m_sps.push_back(sp);//մspӵvector
 
 	ProcessNew((int)m_sps.size()-1);//ʹøմspִProcessNew
-	BudgetMaintenance();
+	BudgetMaintenance(m_config.svmBudgetSize+m_config.svmBudgetSlack);
 	
-	for (int i = 0; i < 10; ++i)//ϵProcessNewReprocess=110
+	for (int i = 0; i < m_config.svmMaxReprocess; ++i)//ϵProcessNewReprocess=110
 	{
+		// stop once the kkt conditions hold to within the tolerance
+		if (m_config.svmTolerance > 0.0 && MaxViolation() < m_config.svmTolerance) break;
+		// the new pattern and the budget are always dealt with, reprocessing
+		// only carries on while there is time left
+		if (OutOfTime()) break;
 		Reprocess();
-		BudgetMaintenance();
+		BudgetMaintenance(m_config.svmBudgetSize+m_config.svmBudgetSlack);
+	}
+	// the budget may only be overshot while the update is running
+	BudgetMaintenance(m_config.svmBudgetSize);
+	
+	if (m_config.svmCompactAge > 0)
+	{
+		for (int i = 0; i < (int)m_sps.size(); ++i)
+		{
+			if (!m_sps[i]->compacted && m_updates-m_sps[i]->time > m_config.svmCompactAge)
+			{
+				CompactPattern(m_sps[i]);
+			}
+		}
+	}
+	
+	Publish();
+	
+	m_updateTime = (int)(1e6*(getTickCount()-m_updateStart)/getTickFrequency());
+}
+
+void LaRank::Publish()
+{
+	// models are never changed once published, readers keep theirs alive
+	int n = m_svs.size();
+	shared_ptr<Model> model(new Model);
+	if (m_w.size() > 0)
+	{
+		model->w = m_w;
+	}
+	else if (n > 0 && m_kernel.IsIntersection())
+	{
+		BuildIntersectionTables(*model);
+	}
+	else if (n > 0)
+	{
+		model->features = m_svs.features.block(0, 0, n, m_svs.features.cols());
+		if (m_svs.norms.cols() > 0)
+		{
+			model->norms = m_svs.norms.block(0, 0, n, m_svs.norms.cols());
+		}
+		model->b = VectorXd::Map(&m_svs.b[0], n);
 	}
+	atomic_store(&m_model, shared_ptr<const Model>(model));
 }
 
-void LaRank::BudgetMaintenance()
+void LaRank::BuildIntersectionTables(Model& model) const
 {
-	if (m_config.svmBudgetSize > 0)
+	// the sort order is kept up to date as svs come and go, only the sums
+	// depend on the betas. svs with a zero beta don't contribute.
+	vector<double> b(m_K.Size(), 0.0);
+	int n = 0;
+	for (int j = 0; j < m_svs.size(); ++j)
 	{
-		while ((int)m_svs.size() > m_config.svmBudgetSize)
+		b[m_svs.slot[j]] = m_svs.b[j];
+		if (m_svs.b[j] != 0.0) ++n;
+	}
+	if (n == 0) return;
+	
+	int dims = (int)m_sorted.size();
+	model.sorted.resize(n, dims);
+	model.lowSum.resize(n+1, dims);
+	model.highBeta.resize(n+1, dims);
+	vector<double> sortedBeta(n);
+	for (int d = 0; d < dims; ++d)
+	{
+		const vector<pair<double, int> >& values = m_sorted[d];
+		int k = 0;
+		model.lowSum(0, d) = 0.0;
+		for (int j = 0; j < (int)values.size(); ++j)
 		{
-			BudgetMaintenanceRemove();
+			double bj = b[values[j].second];
+			if (bj == 0.0) continue;
+			model.sorted(k, d) = values[j].first;
+			model.lowSum(k+1, d) = model.lowSum(k, d) + bj*values[j].first;
+			sortedBeta[k++] = bj;
+		}
+		model.highBeta(n, d) = 0.0;
+		for (int j = n-1; j >= 0; --j)
+		{
+			model.highBeta(j, d) = model.highBeta(j+1, d) + sortedBeta[j];
 		}
 	}
 }
 
+void LaRank::BudgetMaintenance(int limit)
+{
+	if (m_config.svmBudgetSize > 0 && m_svs.size() > limit)
+	{
+		BudgetMaintenanceRemove();
+	}
+}
+
 void LaRank::Reprocess()
 {
 	ProcessOld();
 	for (int i = 0; i < 10; ++i)
 	{
+		if (OutOfTime()) break;
 		Optimize();
 	}
 }
@@ -151,13 +344,13 @@ void LaRank::Reprocess()
 double LaRank::ComputeDual() const
 {
 	double d = 0.0;
-	for (int i = 0; i < (int)m_svs.size(); ++i)
+	for (int i = 0; i < m_svs.size(); ++i)
 	{
-		const SupportVector* sv = m_svs[i];
-		d -= sv->b*Loss(sv->x->yv[sv->y], sv->x->yv[sv->x->y]);
-		for (int j = 0; j < (int)m_svs.size(); ++j)
+		const SupportPattern* sp = m_svs.x[i];
+		d -= m_svs.b[i]*Loss(sp->yv[m_svs.y[i]], sp->yv[sp->y]);
+		for (int j = 0; j < m_svs.size(); ++j)
 		{
-			d -= 0.5*sv->b*m_svs[j]->b*m_K(i,j);
+			d -= 0.5*m_svs.b[i]*m_svs.b[j]*KernelValue(i,j);
 		}
 	}
 	return d;
@@ -167,15 +360,15 @@ void LaRank::SMOStep(int ipos, int ineg)
 {
 	if (ipos == ineg) return;
 
-	SupportVector* svp = m_svs[ipos];
-	SupportVector* svn = m_svs[ineg];
-	assert(svp->x == svn->x);
-	SupportPattern* sp = svp->x;
+	assert(m_svs.x[ipos] == m_svs.x[ineg]);
+	const SupportPattern* sp = m_svs.x[ipos];
+	double gp = m_svs.g[ipos];
+	double gn = m_svs.g[ineg];
 
 #if VERBOSE
-	cout << "SMO: gpos:" << svp->g << " gneg:" << svn->g << endl;
+	cout << "SMO: gpos:" << gp << " gneg:" << gn << endl;
 #endif	
-	if ((svp->g - svn->g) < 1e-5)
+	if ((gp - gn) < 1e-5)
 	{
 #if VERBOSE
 		cout << "SMO: skipping" << endl;
@@ -183,50 +376,56 @@ void LaRank::SMOStep(int ipos, int ineg)
 	}
 	else
 	{
-		double kii = m_K(ipos, ipos) + m_K(ineg, ineg) - 2*m_K(ipos, ineg);
-		double lu = (svp->g-svn->g)/kii;
+		double kii = KernelValue(ipos, ipos) + KernelValue(ineg, ineg) - 2*KernelValue(ipos, ineg);
+		double lu = (gp-gn)/kii;
 		// no need to clamp against 0 since we'd have skipped in that case
-		double l = min(lu, m_C*(int)(svp->y == sp->y) - svp->b);
+		double l = min(lu, m_C*(int)(m_svs.y[ipos] == sp->y) - m_svs.b[ipos]);
 
-		svp->b += l;
-		svn->b -= l;
+		m_svs.b[ipos] += l;
+		m_svs.b[ineg] -= l;
+		AdjustScores(ipos, l);
+		AdjustScores(ineg, -l);
 
 		// update gradients
-		for (int i = 0; i < (int)m_svs.size(); ++i)
+		int kp = m_svs.slot[ipos];
+		int kn = m_svs.slot[ineg];
+		for (int i = 0; i < m_svs.size(); ++i)
 		{
-			SupportVector* svi = m_svs[i];
-			svi->g -= l*(m_K(i, ipos) - m_K(i, ineg));
+			int ki = m_svs.slot[i];
+			m_svs.g[i] -= l*(m_K(ki, kp) - m_K(ki, kn));
 		}
 #if VERBOSE
-		cout << "SMO: " << ipos << "," << ineg << " -- " << svp->b << "," << svn->b << " (" << l << ")" << endl;
+		cout << "SMO: " << ipos << "," << ineg << " -- " << m_svs.b[ipos] << "," << m_svs.b[ineg] << " (" << l << ")" << endl;
 #endif		
 	}
 	
 	// check if we should remove either sv now
 	
-	if (fabs(svp->b) < 1e-8)
+	if (fabs(m_svs.b[ipos]) < 1e-8)
 	{
 		RemoveSupportVector(ipos);
-		if (ineg == (int)m_svs.size())
+		if (ineg == m_svs.size())
 		{
 			// ineg and ipos will have been swapped during sv removal
 			ineg = ipos;
 		}
 	}
 
-	if (fabs(svn->b) < 1e-8)
+	if (fabs(m_svs.b[ineg]) < 1e-8)
 	{
 		RemoveSupportVector(ineg);
 	}
 }
 
-pair<int, double> LaRank::MinGradient(int ind)//indvector sp
+pair<int, double> LaRank::MinGradient(int ind) const//indvector sp
 {
 	const SupportPattern* sp = m_sps[ind];
+	
 	pair<int, double> minGrad(-1, DBL_MAX);
-	for (int i = 0; i < (int)sp->yv.size(); ++i)//Ѱ֧ģʽspgradientСy
+	for (int r = 0; r < (int)sp->labels.size(); ++r)//Ѱ֧ģʽspgradientСy
 	{
-		double grad = -Loss(sp->yv[i], sp->yv[sp->y]) - Evaluate(sp->x[i], sp->yv[i]);
+		int i = sp->labels[r];
+		double grad = -Loss(sp->yv[i], sp->yv[sp->y]) - sp->f[r];
 		if (grad < minGrad.second)
 		{
 			minGrad.first = i;
@@ -236,10 +435,79 @@ pair<int, double> LaRank::MinGradient(int ind)//
 	return minGrad;
 }
 
+double LaRank::PatternViolation(int ind, bool svsOnly) const
+{
+	// the gap between the largest gradient of a label whose beta can
+	// still increase and the smallest gradient of any label, or of any
+	// support vector if svsOnly is set
+	const SupportPattern* sp = m_sps[ind];
+	double maxGrad = -DBL_MAX;
+	double minGrad = DBL_MAX;
+	bool ySV = false;
+	for (int k = 0; k < (int)sp->svs.size(); ++k)
+	{
+		int i = sp->svs[k];
+		if (m_svs.y[i] == sp->y) ySV = true;
+		if (m_svs.g[i] > maxGrad && m_svs.b[i] < m_C*(int)(m_svs.y[i] == sp->y))
+		{
+			maxGrad = m_svs.g[i];
+		}
+		minGrad = min(minGrad, m_svs.g[i]);
+	}
+	if (svsOnly) return maxGrad - minGrad;
+	
+	if (!ySV)
+	{
+		// gradient is -f(x,y) since loss=0
+		maxGrad = max(maxGrad, -sp->f[sp->rows[sp->y]]);
+	}
+	return maxGrad - MinGradient(ind).second;
+}
+
+double LaRank::MaxViolation() const
+{
+	double v = 0.0;
+	for (int ind = 0; ind < (int)m_sps.size(); ++ind)
+	{
+		v = max(v, PatternViolation(ind, false));
+	}
+	return v;
+}
+
+int LaRank::ChoosePattern(bool svsOnly) const
+{
+	if (m_config.svmUpdateBudget <= 0)
+	{
+		return rand() % m_sps.size();
+	}
+	
+	// with a time budget spend it where the dual can gain the most, which
+	// is taken to be the pattern furthest from its kkt conditions
+	int ind = 0;
+	double maxViolation = -DBL_MAX;
+	for (int i = 0; i < (int)m_sps.size(); ++i)
+	{
+		double v = PatternViolation(i, svsOnly);
+		if (v > maxViolation)
+		{
+			ind = i;
+			maxViolation = v;
+		}
+	}
+	return ind;
+}
+
+bool LaRank::OutOfTime() const
+{
+	return m_config.svmUpdateBudget > 0 &&
+		1e6*(getTickCount()-m_updateStart)/getTickFrequency() > m_config.svmUpdateBudget;
+}
+
 void LaRank::ProcessNew(int ind)//֧betaֵ
 {
 	// gradient is -f(x,y) since loss=0
-	int ip = AddSupportVector(m_sps[ind], m_sps[ind]->y, -Evaluate(m_sps[ind]->x[m_sps[ind]->y],m_sps[ind]->yv[m_sps[ind]->y]));
+	const SupportPattern* sp = m_sps[ind];
+	int ip = AddSupportVector(m_sps[ind], sp->y, -sp->f[sp->rows[sp->y]]);
 
 	pair<int, double> minGrad = MinGradient(ind);//xʹݶСy
 	int in = AddSupportVector(m_sps[ind], minGrad.first, minGrad.second);
@@ -252,20 +520,19 @@ void LaRank::ProcessOld()
 	if (m_sps.size() == 0) return;
 
 	// choose pattern to process
-	int ind = rand() % m_sps.size();//ѡȡһsp
+	int ind = ChoosePattern(false);//ѡȡһsp
 
 	// find existing sv with largest grad and nonzero beta
+	const SupportPattern* sp = m_sps[ind];
 	int ip = -1;
 	double maxGrad = -DBL_MAX;
-	for (int i = 0; i < (int)m_svs.size(); ++i)//ÿһ֧
+	for (int k = 0; k < (int)sp->svs.size(); ++k)//spӦÿһ֧
 	{
-		if (m_svs[i]->x != m_sps[ind]) continue;//ҵspӦsv
-
-		const SupportVector* svi = m_svs[i];//copysv
-		if (svi->g > maxGrad && svi->b < m_C*(int)(svi->y == m_sps[ind]->y))//gradientsvҪbetaԼ
+		int i = sp->svs[k];
+		if (m_svs.g[i] > maxGrad && m_svs.b[i] < m_C*(int)(m_svs.y[i] == sp->y))//gradientsvҪbetaԼ
 		{
 			ip = i;
-			maxGrad = svi->g;
+			maxGrad = m_svs.g[i];
 		}
 	}
 	assert(ip != -1);
@@ -274,11 +541,10 @@ void LaRank::ProcessOld()
 	// find potentially new sv with smallest grad
 	pair<int, double> minGrad = MinGradient(ind);
 	int in = -1;
-	for (int i = 0; i < (int)m_svs.size(); ++i)//ÿһ֧
+	for (int k = 0; k < (int)sp->svs.size(); ++k)//spӦÿһ֧
 	{
-		if (m_svs[i]->x != m_sps[ind]) continue;//ҵspӦsv
-
-		if (m_svs[i]->y == minGrad.first)//y֧vector
+		int i = sp->svs[k];
+		if (m_svs.y[i] == minGrad.first)//y֧vector
 		{
 			in = i;
 			break;
@@ -298,26 +564,25 @@ void LaRank::Optimize()
 	if (m_sps.size() == 0) return;
 	
 	// choose pattern to optimize
-	int ind = rand() % m_sps.size();
+	int ind = ChoosePattern(true);
 
+	const SupportPattern* sp = m_sps[ind];
 	int ip = -1;
 	int in = -1;
 	double maxGrad = -DBL_MAX;
 	double minGrad = DBL_MAX;
-	for (int i = 0; i < (int)m_svs.size(); ++i)
+	for (int k = 0; k < (int)sp->svs.size(); ++k)
 	{
-		if (m_svs[i]->x != m_sps[ind]) continue;
-
-		const SupportVector* svi = m_svs[i];
-		if (svi->g > maxGrad && svi->b < m_C*(int)(svi->y == m_sps[ind]->y))
+		int i = sp->svs[k];
+		if (m_svs.g[i] > maxGrad && m_svs.b[i] < m_C*(int)(m_svs.y[i] == sp->y))
 		{
 			ip = i;
-			maxGrad = svi->g;
+			maxGrad = m_svs.g[i];
 		}
-		if (svi->g < minGrad)
+		if (m_svs.g[i] < minGrad)
 		{
 			in = i;
-			minGrad = svi->g;
+			minGrad = m_svs.g[i];
 		}
 	}
 	assert(ip != -1 && in != -1);
@@ -333,44 +598,104 @@ void LaRank::Optimize()
 
 int LaRank::AddSupportVector(SupportPattern* x, int y, double g)
 {
-	SupportVector* sv = new SupportVector;
-	sv->b = 0.0;
-	sv->x = x;
-	sv->y = y;
-	sv->g = g;
-
-	int ind = (int)m_svs.size();
-	m_svs.push_back(sv);
-	x->refCount++;//spsvĸ1
+	int ind = m_svs.size();
+	if (ind == m_svs.features.rows())
+	{
+		// grow the sv store
+		RowFeatureMatrix grown(2*ind, m_svs.features.cols());
+		grown.block(0, 0, ind, grown.cols()) = m_svs.features;
+		m_svs.features = grown;
+		if (m_svs.norms.cols() > 0)
+		{
+			MatrixXd norms(2*ind, m_svs.norms.cols());
+			norms.block(0, 0, ind, norms.cols()) = m_svs.norms;
+			m_svs.norms = norms;
+		}
+	}
+	m_svs.features.row(ind) = x->x.row(x->rows[y]);
+	// kernels without norms give them no columns, which eigen has no rows of
+	if (m_svs.norms.cols() > 0)
+	{
+		m_svs.norms.row(ind) = x->norms.row(x->rows[y]);
+	}
+	m_svs.x.push_back(x);
+	m_svs.y.push_back(y);
+	m_svs.b.push_back(0.0);
+	m_svs.g.push_back(g);
+	int slot = m_K.Add();
+	m_svs.slot.push_back(slot);
+	x->svs.push_back(ind);//spsvĸ1
+	for (int d = 0; d < (int)m_sorted.size(); ++d)
+	{
+		pair<double, int> v((double)m_svs.features(ind, d), slot);
+		m_sorted[d].insert(lower_bound(m_sorted[d].begin(), m_sorted[d].end(), v), v);
+	}
 
 #if VERBOSE
 	cout << "Adding SV: " << ind << endl;
 #endif
 
-	// update kernel matrix
+	// extend the kernel cache of every pattern with the new sv, the
+	// scores don't change since its beta is zero
+	RowFeatureView s = RowFeatureView(m_svs.features).block(ind, 0, 1, m_svs.features.cols());
+	ViewXd sn = ViewXd(m_svs.norms).block(ind, 0, 1, m_svs.norms.cols());
+	for (int i = 0; i < (int)m_sps.size(); ++i)
+	{
+		SupportPattern* sp = m_sps[i];
+		if (slot >= sp->k.cols())
+		{
+			KernelMatrix grown(sp->k.rows(), max(2*sp->k.cols(), slot+1));
+			grown.block(0, 0, sp->k.rows(), sp->k.cols()) = sp->k;
+			sp->k = grown;
+		}
+		Reserve(m_update.k, sp->x.rows(), 1);
+		FeatureView k = FeatureView(m_update.k).block(0, 0, sp->x.rows(), 1);
+		m_kernel.EvalBlock(sp->x, sp->norms, s, sn, k);
+		for (int r = 0; r < k.rows(); ++r)
+		{
+			sp->k(r, slot) = (kernel_cache_t)k(r, 0);
+		}
+	}
+
+	// update kernel matrix, all the values are already in the pattern caches
 	for (int i = 0; i < ind; ++i)
 	{
-		m_K(i,ind) = m_kernel.Eval(m_svs[i]->x->x[m_svs[i]->y], x->x[y]);
-		m_K(ind,i) = m_K(i,ind);
+		const SupportPattern* sp = m_svs.x[i];
+		m_K.Set(m_svs.slot[i], slot, sp->k(sp->rows[m_svs.y[i]], slot));
 	}
-	m_K(ind,ind) = m_kernel.Eval(x->x[y]);
+	// the svs are stored row by row, so the new one is evaluated in place
+	// unless it has to be widened to double first
+#ifdef STRUCK_FLOAT
+	m_update.x = m_svs.features.row(ind).transpose().cast<double>();
+	const double* sv = m_update.x.data();
+#else
+	const double* sv = m_svs.features.row(ind).data();
+#endif
+	m_K.Set(slot, slot, m_kernel.Eval(sv, m_svs.features.cols()));
 
 	return ind;
 }
 
 void LaRank::SwapSupportVectors(int ind1, int ind2)
 {
-	SupportVector* tmp = m_svs[ind1];
-	m_svs[ind1] = m_svs[ind2];
-	m_svs[ind2] = tmp;
-	
-	VectorXd row1 = m_K.row(ind1);
-	m_K.row(ind1) = m_K.row(ind2);
-	m_K.row(ind2) = row1;
+	// point the patterns' sv lists at the new positions
+	vector<int>& svs1 = m_svs.x[ind1]->svs;
+	vector<int>& svs2 = m_svs.x[ind2]->svs;
+	int k1 = (int)(find(svs1.begin(), svs1.end(), ind1) - svs1.begin());
+	int k2 = (int)(find(svs2.begin(), svs2.end(), ind2) - svs2.begin());
+	svs1[k1] = ind2;
+	svs2[k2] = ind1;
 	
-	VectorXd col1 = m_K.col(ind1);
-	m_K.col(ind1) = m_K.col(ind2);
-	m_K.col(ind2) = col1;
+	swap(m_svs.x[ind1], m_svs.x[ind2]);
+	swap(m_svs.y[ind1], m_svs.y[ind2]);
+	swap(m_svs.b[ind1], m_svs.b[ind2]);
+	swap(m_svs.g[ind1], m_svs.g[ind2]);
+	swap(m_svs.slot[ind1], m_svs.slot[ind2]);
+	m_svs.features.row(ind1).swap(m_svs.features.row(ind2));
+	if (m_svs.norms.cols() > 0)
+	{
+		m_svs.norms.row(ind1).swap(m_svs.norms.row(ind2));
+	}
 }
 
 void LaRank::RemoveSupportVector(int ind)
@@ -379,91 +704,282 @@ void LaRank::RemoveSupportVector(int ind)
 	cout << "Removing SV: " << ind << endl;
 #endif	
 
-	m_svs[ind]->x->refCount--;
-	if (m_svs[ind]->x->refCount == 0)
+	for (int d = 0; d < (int)m_sorted.size(); ++d)
 	{
-		// also remove the support pattern
-		for (int i = 0; i < (int)m_sps.size(); ++i)
-		{
-			if (m_sps[i] == m_svs[ind]->x)
-			{
-				delete m_sps[i];
-				m_sps.erase(m_sps.begin()+i);
-				break;
-			}
-		}
+		pair<double, int> v((double)m_svs.features(ind, d), m_svs.slot[ind]);
+		m_sorted[d].erase(lower_bound(m_sorted[d].begin(), m_sorted[d].end(), v));
 	}
+	
+	// the kernel values stay where they are, only the slot is recycled
+	m_K.Remove(m_svs.slot[ind]);
 
-	// make sure the support vector is at the back, this
-	// lets us keep the kernel matrix cached and valid
-	if (ind < (int)m_svs.size()-1)
+	// keep the sv store compact by moving the support vector to the back
+	int last = m_svs.size()-1;
+	if (ind < last)
+	{
+		SwapSupportVectors(ind, last);
+	}
+	
+	SupportPattern* sp = m_svs.x[last];
+	vector<int>::iterator it = find(sp->svs.begin(), sp->svs.end(), last);
+	*it = sp->svs.back();
+	sp->svs.pop_back();
+	if (sp->svs.empty())
 	{
-		SwapSupportVectors(ind, (int)m_svs.size()-1);
-		ind = (int)m_svs.size()-1;
+		// also remove the support pattern, the last one takes its place
+		m_sps[sp->ind] = m_sps.back();
+		m_sps[sp->ind]->ind = sp->ind;
+		m_sps.pop_back();
+		delete sp;
 	}
-	delete m_svs[ind];
-	m_svs.pop_back();
+	
+	m_svs.x.pop_back();
+	m_svs.y.pop_back();
+	m_svs.b.pop_back();
+	m_svs.g.pop_back();
+	m_svs.slot.pop_back();
 }
 
 void LaRank::BudgetMaintenanceRemove()
 {
-	// find negative sv with smallest effect on discriminant function if removed
-	double minVal = DBL_MAX;
-	int in = -1;
-	int ip = -1;
-	for (int i = 0; i < (int)m_svs.size(); ++i)
+	// rank the negative svs by their effect on the discriminant function
+	// if removed. the effect only depends on the sv and the positive sv of
+	// its pattern, so removing one doesn't change the others' ranks
+	int n = m_svs.size();
+	vector<pair<double, int> > ranked;
+	vector<int> partner(n, -1);
+	for (int i = 0; i < n; ++i)
 	{
-		if (m_svs[i]->b < 0.0)
+		if (m_svs.b[i] < 0.0)
 		{
 			// find corresponding positive sv
+			const vector<int>& svs = m_svs.x[i]->svs;
 			int j = -1;
-			for (int k = 0; k < (int)m_svs.size(); ++k)
+			for (int k = 0; k < (int)svs.size(); ++k)
 			{
-				if (m_svs[k]->b > 0.0 && m_svs[k]->x == m_svs[i]->x)
+				if (m_svs.b[svs[k]] > 0.0)
 				{
-					j = k;
+					j = svs[k];
 					break;
 				}
 			}
-			double val = m_svs[i]->b*m_svs[i]->b*(m_K(i,i) + m_K(j,j) - 2.0*m_K(i,j));
-			if (val < minVal)
-			{
-				minVal = val;
-				in = i;
-				ip = j;
-			}
+			double val = m_svs.b[i]*m_svs.b[i]*(KernelValue(i,i) + KernelValue(j,j) - 2.0*KernelValue(i,j));
+			ranked.push_back(make_pair(val, i));
+			partner[i] = j;
+		}
+	}
+	sort(ranked.begin(), ranked.end());
+
+	// remove the cheapest negative svs until the budget is met, adjusting
+	// the weight of the positive sv to compensate for each one
+	vector<double> db(n, 0.0);
+	vector<bool> removed(n, false);
+	int left = n;
+	int removals = 0;
+	for (int k = 0; k < (int)ranked.size() && left > m_config.svmBudgetSize; ++k)
+	{
+		int in = ranked[k].second;
+		int ip = partner[in];
+		double bn = m_svs.b[in];
+		db[in] -= bn;
+		m_svs.b[in] = 0.0;
+		removed[in] = true;
+		--left;
+		++removals;
+		
+		// the positive sv went with an earlier negative of its pattern,
+		// whose betas sum to zero, so this one is only rounding left over
+		if (removed[ip]) continue;
+		
+		m_svs.b[ip] += bn;
+		db[ip] += bn;
+		if (m_svs.b[ip] < 1e-8)
+		{
+			// also remove positive sv
+			db[ip] -= m_svs.b[ip];
+			m_svs.b[ip] = 0.0;
+			removed[ip] = true;
+			--left;
 		}
 	}
 
-	// adjust weight of positive sv to compensate for removal of negative
-	m_svs[ip]->b += m_svs[in]->b;
+	// repair the gradients and scores once for all the beta changes, the
+	// discriminant function changes by sum_j db_j*k(x,j)
+	vector<int> changed;
+	for (int j = 0; j < n; ++j)
+	{
+		if (db[j] != 0.0) changed.push_back(j);
+	}
+	for (int i = 0; i < n; ++i)
+	{
+		if (removed[i]) continue;
+		for (int k = 0; k < (int)changed.size(); ++k)
+		{
+			m_svs.g[i] -= db[changed[k]]*KernelValue(i, changed[k]);
+		}
+	}
+	for (int k = 0; k < (int)changed.size(); ++k)
+	{
+		AdjustScores(changed[k], db[changed[k]]);
+	}
 
-	// remove negative sv
-	RemoveSupportVector(in);
-	if (ip == (int)m_svs.size())
+	// removal moves the last sv into the gap, so going from the back
+	// only ever moves svs which are kept
+	for (int i = n-1; i >= 0; --i)
 	{
-		// ip and in will have been swapped during support vector removal
-		ip = in;
+		if (removed[i]) RemoveSupportVector(i);
+	}
+
+	// periodically resynchronise to stop rounding errors accumulating
+	m_budgetRemovals += removals;
+	if (m_budgetRemovals >= kGradientResyncInterval)
+	{
+		m_budgetRemovals = 0;
+		RecomputeGradients();
+	}
+}
+
+void LaRank::RecomputeGradients()
+{
+	int n = m_svs.size();
+	for (int i = 0; i < n; ++i)
+	{
+		const SupportPattern* sp = m_svs.x[i];
+		double f = 0.0;
+		for (int j = 0; j < n; ++j)
+		{
+			f += m_svs.b[j]*KernelValue(i,j);
+		}
+		m_svs.g[i] = -Loss(sp->yv[m_svs.y[i]], sp->yv[sp->y]) - f;
+	}
+	
+	// and the cached scores
+	for (int i = 0; i < (int)m_sps.size(); ++i)
+	{
+		SupportPattern* sp = m_sps[i];
+		sp->f.setZero();
+		for (int j = 0; j < n; ++j)
+		{
+			sp->f += m_svs.b[j]*sp->k.col(m_svs.slot[j]).cast<double>();
+		}
+	}
+	
+	// and the weight vector
+	if (m_w.size() > 0)
+	{
+		m_w.setZero();
+		for (int j = 0; j < n; ++j)
+		{
+			m_w += m_svs.b[j]*m_svs.features.row(j).transpose().cast<double>();
+		}
+	}
+}
+
+void LaRank::InitialiseScores(SupportPattern* sp) const
+{
+	int n = m_svs.size();
+	sp->k.resize(sp->x.rows(), m_K.Size()+kScoreColumnSlack);
+	sp->f = VectorXd::Zero(sp->x.rows());
+	if (n == 0) return;
+	
+	// the svs are viewed in place
+	FeatureMatrix K(sp->x.rows(), n);
+	m_kernel.EvalBlock(sp->x, sp->norms, RowFeatureView(m_svs.features).block(0, 0, n, m_svs.features.cols()),
+		ViewXd(m_svs.norms).block(0, 0, n, m_svs.norms.cols()), K);
+	for (int j = 0; j < n; ++j)
+	{
+		sp->k.col(m_svs.slot[j]) = K.col(j).cast<kernel_cache_t>();
+	}
+	sp->f = K.cast<double>()*VectorXd::Map(&m_svs.b[0], n);
+}
+
+void LaRank::AdjustScores(int ind, double db)
+{
+	// the beta of sv ind has changed by db
+	for (int i = 0; i < (int)m_sps.size(); ++i)
+	{
+		SupportPattern* sp = m_sps[i];
+		sp->f += db*sp->k.col(m_svs.slot[ind]).cast<double>();
+	}
+	if (m_w.size() > 0)
+	{
+		m_w += db*m_svs.features.row(ind).transpose().cast<double>();
+	}
+}
+
+void LaRank::CompactPattern(SupportPattern* sp)
+{
+	// keep only the labels which are support vectors, the rest are
+	// dropped and stop being candidates for new support vectors
+	vector<bool> keep(sp->yv.size(), false);
+	keep[sp->y] = true;
+	for (int k = 0; k < (int)sp->svs.size(); ++k)
+	{
+		keep[m_svs.y[sp->svs[k]]] = true;
+	}
+	
+	vector<int> labels;
+	vector<int> rows(sp->yv.size(), -1);
+	for (int r = 0; r < (int)sp->labels.size(); ++r)
+	{
+		if (!keep[sp->labels[r]]) continue;
+		rows[sp->labels[r]] = (int)labels.size();
+		labels.push_back(sp->labels[r]);
 	}
 	
-	if (m_svs[ip]->b < 1e-8)
+	int n = (int)labels.size();
+	FeatureMatrix x(n, sp->x.cols());
+	MatrixXd norms(n, sp->norms.cols());
+	KernelMatrix k(n, sp->k.cols());
+	VectorXd f(n);
+	for (int r = 0; r < n; ++r)
+	{
+		int old = sp->rows[labels[r]];
+		x.row(r) = sp->x.row(old);
+		if (norms.cols() > 0) norms.row(r) = sp->norms.row(old);
+		k.row(r) = sp->k.row(old);
+		f[r] = sp->f[old];
+	}
+	sp->x = x;
+	sp->norms = norms;
+	sp->k = k;
+	sp->f = f;
+	sp->labels = labels;
+	sp->rows = rows;
+	for (int i = 0; i < (int)sp->images.size(); ++i)
 	{
-		// also remove positive sv
-		RemoveSupportVector(ip);
+		if (!keep[i]) sp->images[i].release();
 	}
+	sp->compacted = true;
+}
 
-	// update gradients
-	// TODO: this could be made cheaper by just adjusting incrementally rather than recomputing
-	for (int i = 0; i < (int)m_svs.size(); ++i)
+size_t LaRank::MemoryUsage() const
+{
+	size_t bytes = m_K.MemoryUsage() + sizeof(feature_t)*m_svs.features.rows()*m_svs.features.cols();
+	bytes += sizeof(double)*m_svs.norms.rows()*m_svs.norms.cols();
+	bytes += m_svs.size()*(sizeof(SupportPattern*) + 2*sizeof(int) + 2*sizeof(double));
+	for (int i = 0; i < (int)m_sps.size(); ++i)
 	{
-		SupportVector& svi = *m_svs[i];
-		svi.g = -Loss(svi.x->yv[svi.y],svi.x->yv[svi.x->y]) - Evaluate(svi.x->x[svi.y], svi.x->yv[svi.y]);
-	}	
+		const SupportPattern* sp = m_sps[i];
+		bytes += sizeof(SupportPattern);
+		bytes += sizeof(feature_t)*sp->x.rows()*sp->x.cols() + sizeof(kernel_cache_t)*sp->k.rows()*sp->k.cols() + sizeof(double)*sp->f.size();
+		bytes += sizeof(double)*sp->norms.rows()*sp->norms.cols();
+		bytes += sizeof(FloatRect)*sp->yv.size() + sizeof(int)*(sp->labels.size() + sp->rows.size() + sp->svs.size());
+		for (int j = 0; j < (int)sp->images.size(); ++j)
+		{
+			bytes += sp->images[j].rows*sp->images[j].cols;
+		}
+	}
+	return bytes;
 }
 
 void LaRank::Debug()
 {
-	cout << m_sps.size() << "/" << m_svs.size() << " support patterns/vectors" << endl;
+	cout << m_sps.size() << "/" << m_svs.size() << " support patterns/vectors, " << MemoryUsage()/1024 << " KB" << endl;
+	cout << "dual: " << ComputeDual() << " max kkt violation: " << MaxViolation() << endl;
+	cout << "update: " << m_updateTime << " us";
+	if (m_config.svmUpdateBudget > 0) cout << " of " << m_config.svmUpdateBudget << " us budget";
+	cout << endl;
 	UpdateDebugImage();
 	imshow("learner", m_debugImage);
 }
@@ -490,25 +1006,24 @@ void LaRank::UpdateDebugImage()
 	int x = 0;
 	int y = 0;
 	int ind = 0;
-	float vals[kMaxSVs];
-	memset(vals, 0, sizeof(float)*n);
-	int drawOrder[kMaxSVs];
+	vector<float> vals(n, 0.f);
+	vector<int> drawOrder(n);
 	
 	for (int set = 0; set < 2; ++set)
 	{
 		for (int i = 0; i < n; ++i)
 		{
-			if (((set == 0) ? 1 : -1)*m_svs[i]->b < 0.0) continue;
+			if (((set == 0) ? 1 : -1)*m_svs.b[i] < 0.0) continue;
 			
 			drawOrder[ind] = i;
-			vals[ind] = (float)m_svs[i]->b;
+			vals[ind] = (float)m_svs.b[i];
 			++ind;
 			
 			Mat I = m_debugImage(cv::Rect(x, y, tileSize, tileSize));
-			resize(m_svs[i]->x->images[m_svs[i]->y], temp, temp.size());
+			resize(m_svs.x[i]->images[m_svs.y[i]], temp, temp.size());
 			cvtColor(temp, I, CV_GRAY2RGB);
 			double w = 1.0;
-			rectangle(I, Point(0, 0), Point(tileSize-1, tileSize-1), (m_svs[i]->b > 0.0) ? CV_RGB(0, (uchar)(255*w), 0) : CV_RGB((uchar)(255*w), 0, 0), 3);
+			rectangle(I, Point(0, 0), Point(tileSize-1, tileSize-1), (m_svs.b[i] > 0.0) ? CV_RGB(0, (uchar)(255*w), 0) : CV_RGB((uchar)(255*w), 0, 0), 3);
 			x += tileSize;
 			if ((x+tileSize) > kCanvasSize)
 			{
@@ -521,8 +1036,16 @@ void LaRank::UpdateDebugImage()
 	const int kKernelPixelSize = 2;
 	int kernelSize = kKernelPixelSize*n;
 	
-	double kmin = m_K.minCoeff();
-	double kmax = m_K.maxCoeff();
+	double kmin = DBL_MAX;
+	double kmax = -DBL_MAX;
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j <= i; ++j)
+		{
+			kmin = min(kmin, KernelValue(i, j));
+			kmax = max(kmax, KernelValue(i, j));
+		}
+	}
 	
 	if (kernelSize < m_debugImage.cols && kernelSize < m_debugImage.rows)
 	{
@@ -532,7 +1055,7 @@ void LaRank::UpdateDebugImage()
 			for (int j = 0; j < n; ++j)
 			{
 				Mat Kij = K(cv::Rect(j*kKernelPixelSize, i*kKernelPixelSize, kKernelPixelSize, kKernelPixelSize));
-				uchar v = (uchar)(255*(m_K(drawOrder[i], drawOrder[j])-kmin)/(kmax-kmin));
+				uchar v = (uchar)(255*(KernelValue(drawOrder[i], drawOrder[j])-kmin)/(kmax-kmin));
 				Kij.setTo(Scalar(v, v, v));
 			}
 		}
@@ -547,5 +1070,5 @@ void LaRank::UpdateDebugImage()
 	I.setTo(Scalar(255,255,255));
 	IplImage II = I;
 	setGraphColor(0);
-	drawFloatGraph(vals, n, &II, 0.f, 0.f, I.cols, I.rows);
+	drawFloatGraph(&vals[0], n, &II, 0.f, 0.f, I.cols, I.rows);
 }
@@ -0,0 +1,204 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "Pipeline.h"
+#include "Config.h"
+
+#include "HaarFeatures.h"
+#include "RawFeatures.h"
+#include "HistogramFeatures.h"
+#include "MultiFeatures.h"
+#include "KernelMapFeatures.h"
+#include "RandomFourierFeatures.h"
+
+using namespace std;
+
+static bool UsesKernelMap(const Config::FeatureKernelPair& fkp)
+{
+	if (fkp.kernel == Config::kKernelTypeGaussian)
+	{
+		return fkp.params.size() > 1 && fkp.params[1] > 0;
+	}
+	return (fkp.kernel == Config::kKernelTypeIntersection || fkp.kernel == Config::kKernelTypeChi2) &&
+		fkp.params.size() > 0 && fkp.params[0] > 0;
+}
+
+static Kernel* CreateKernel(const Config& conf, const Config::FeatureKernelPair& fkp)
+{
+	if (UsesKernelMap(fkp))
+	{
+		// the kernel is approximated by the feature map
+		return new LinearKernel();
+	}
+	
+	switch (fkp.kernel)
+	{
+	case Config::kKernelTypeLinear:
+		return new LinearKernel();
+	case Config::kKernelTypeGaussian:
+		return new GaussianKernel(fkp.params[0], conf.gaussianFastExp);
+	case Config::kKernelTypeIntersection:
+		return new IntersectionKernel();
+	case Config::kKernelTypeChi2:
+		return new Chi2Kernel();
+	}
+	return 0;
+}
+
+template <typename F>
+static Pipeline* CreateStatic(const Config& conf, const Config::FeatureKernelPair& fkp)
+{
+	switch (fkp.kernel)
+	{
+	case Config::kKernelTypeLinear:
+		return new StaticPipeline<F, LinearKernel>(conf, LinearKernel());
+	case Config::kKernelTypeGaussian:
+		return new StaticPipeline<F, GaussianKernel>(conf, GaussianKernel(fkp.params[0], conf.gaussianFastExp));
+	case Config::kKernelTypeIntersection:
+		return new StaticPipeline<F, IntersectionKernel>(conf, IntersectionKernel());
+	case Config::kKernelTypeChi2:
+		return new StaticPipeline<F, Chi2Kernel>(conf, Chi2Kernel());
+	}
+	return 0;
+}
+
+Pipeline* Pipeline::Create(const Config& conf)
+{
+	if (conf.features.size() == 1 && !UsesKernelMap(conf.features[0]))
+	{
+		const Config::FeatureKernelPair& fkp = conf.features[0];
+		switch (fkp.feature)
+		{
+		case Config::kFeatureTypeHaar:
+			return CreateStatic<HaarFeatures>(conf, fkp);
+		case Config::kFeatureTypeRaw:
+			return CreateStatic<RawFeatures>(conf, fkp);
+		case Config::kFeatureTypeHistogram:
+			return CreateStatic<HistogramFeatures>(conf, fkp);
+		}
+	}
+	return new DynamicPipeline(conf);
+}
+
+Pipeline::Pipeline(const Config& conf) :
+	m_needsIntegralImage(false),
+	m_needsIntegralHist(false)
+{
+	for (int i = 0; i < (int)conf.features.size(); ++i)
+	{
+		switch (conf.features[i].feature)
+		{
+		case Config::kFeatureTypeHaar:
+			m_needsIntegralImage = true;
+			break;
+		case Config::kFeatureTypeHistogram:
+			m_needsIntegralHist = true;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+DynamicPipeline::DynamicPipeline(const Config& conf) :
+	Pipeline(conf),
+	m_config(conf)
+{
+	CreateFeatures(m_features);
+	if (m_config.asyncUpdate)
+	{
+		// features keep per-sample state, so scoring gets its own
+		CreateFeatures(m_evalFeatures);
+	}
+	
+	int numFeatures = m_config.features.size();
+	vector<int> featureCounts;
+	for (int i = 0; i < numFeatures; ++i)
+	{
+		featureCounts.push_back(m_features[i]->GetCount());
+		m_kernels.push_back(CreateKernel(m_config, m_config.features[i]));
+	}
+	
+	if (numFeatures > 1)
+	{
+		MultiKernel* k = new MultiKernel(m_kernels, featureCounts);
+		m_kernels.push_back(k);
+	}
+}
+
+DynamicPipeline::~DynamicPipeline()
+{
+	for (int i = 0; i < (int)m_features.size(); ++i)
+	{
+		delete m_features[i];
+		delete m_kernels[i];
+	}
+	for (int i = 0; i < (int)m_evalFeatures.size(); ++i)
+	{
+		delete m_evalFeatures[i];
+	}
+}
+
+void DynamicPipeline::CreateFeatures(vector<Features*>& features)
+{
+	int numFeatures = m_config.features.size();
+	for (int i = 0; i < numFeatures; ++i)
+	{
+		const Config::FeatureKernelPair& fkp = m_config.features[i];
+		switch (fkp.feature)
+		{
+		case Config::kFeatureTypeHaar:
+			features.push_back(new HaarFeatures(m_config));
+			break;
+		case Config::kFeatureTypeRaw:
+			features.push_back(new RawFeatures(m_config));
+			break;
+		case Config::kFeatureTypeHistogram:
+			features.push_back(new HistogramFeatures(m_config));
+			break;
+		}
+		
+		if (UsesKernelMap(fkp))
+		{
+			if (fkp.kernel == Config::kKernelTypeGaussian)
+			{
+				features.back() = new RandomFourierFeatures(features.back(), fkp.params[0], (int)fkp.params[1], m_config.seed);
+			}
+			else
+			{
+				features.back() = new KernelMapFeatures(features.back(), fkp.kernel, (int)fkp.params[0]);
+			}
+		}
+	}
+	
+	if (numFeatures > 1)
+	{
+		MultiFeatures* f = new MultiFeatures(features);
+		features.push_back(f);
+	}
+}
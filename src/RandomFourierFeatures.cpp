@@ -0,0 +1,92 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "RandomFourierFeatures.h"
+
+#include <cmath>
+#include <random>
+
+using namespace Eigen;
+using namespace std;
+
+RandomFourierFeatures::RandomFourierFeatures(Features* features, double sigma, int dim, int seed) :
+	m_features(features),
+	m_scale(sqrt(2.0/dim))
+{
+	// the fourier transform of exp(-sigma*||d||^2) is a gaussian with
+	// variance 2*sigma per dimension. the generator is separate from rand()
+	// so the learner sees the same random sequence whatever the dimension.
+	mt19937 rng(seed);
+	normal_distribution<double> frequency(0.0, sqrt(2.0*sigma));
+	uniform_real_distribution<double> phase(0.0, 2.0*M_PI);
+	
+	int d = features->GetCount();
+	m_omega.resize(d, dim);
+	m_phase.resize(dim);
+	for (int j = 0; j < dim; ++j)
+	{
+		for (int i = 0; i < d; ++i)
+		{
+			m_omega(i,j) = frequency(rng);
+		}
+		m_phase[j] = phase(rng);
+	}
+	
+	SetCount(dim);
+}
+
+RandomFourierFeatures::~RandomFourierFeatures()
+{
+	delete m_features;
+}
+
+void RandomFourierFeatures::Eval(const MultiSample& s, MatrixXd& featMat)
+{
+	MatrixXd x;
+	m_features->Eval(s, x);
+	
+	// all the projections in one matrix product
+	featMat = x*m_omega;
+	for (int j = 0; j < featMat.cols(); ++j)
+	{
+		for (int r = 0; r < featMat.rows(); ++r)
+		{
+			featMat(r,j) = m_scale*cos(featMat(r,j)+m_phase[j]);
+		}
+	}
+}
+
+void RandomFourierFeatures::UpdateFeatureVector(const Sample& s)
+{
+	const VectorXd& x = m_features->Eval(s);
+	m_featVec = m_omega.transpose()*x;
+	for (int j = 0; j < m_featVec.size(); ++j)
+	{
+		m_featVec[j] = m_scale*cos(m_featVec[j]+m_phase[j]);
+	}
+}
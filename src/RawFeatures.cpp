@@ -35,15 +35,26 @@
 using namespace Eigen;
 using namespace cv;
 
-static const int kPatchSize = 16;
-
 RawFeatures::RawFeatures(const Config& conf) :
 	m_patchImage(kPatchSize, kPatchSize, CV_8UC1)
 {
-	SetCount(kPatchSize*kPatchSize);
+	SetCount(kCount);
 }
 
 void RawFeatures::UpdateFeatureVector(const Sample& s)
+{
+	Fill(s, m_featVec.data(), 1);
+}
+
+void RawFeatures::Fill(const MultiSample& s, double* out, int stride)
+{
+	for (int i = 0; i < (int)s.GetRects().size(); ++i)
+	{
+		Fill(s.GetSample(i), out+i, stride);
+	}
+}
+
+void RawFeatures::Fill(const Sample& s, double* out, int stride)
 {
 	IntRect rect = s.GetROI(); // note this truncates to integers
 	cv::Rect roi(rect.XMin(), rect.YMin(), rect.Width(), rect.Height());
@@ -56,7 +67,7 @@ void RawFeatures::UpdateFeatureVector(const Sample& s)
 		uchar* pixel = m_patchImage.ptr(i);
 		for (int j = 0; j < kPatchSize; ++j, ++pixel, ++ind)
 		{
-			m_featVec[ind] = ((double)*pixel)/255;
+			out[ind*stride] = ((double)*pixel)/255;
 		}
 	}
 }
@@ -31,14 +31,7 @@
 #include "Sampler.h"
 #include "Sample.h"
 #include "GraphUtils.h"
-
-#include "HaarFeatures.h"
-#include "RawFeatures.h"
-#include "HistogramFeatures.h"
-#include "MultiFeatures.h"
-
-#include "Kernels.h"
-
+#include "Pipeline.h"
 #include "LaRank.h"
 
 #include <opencv/cv.h>
@@ -56,96 +49,42 @@ using namespace Eigen;
 Tracker::Tracker(const Config& conf) :
 	m_config(conf),
 	m_initialised(false),
+	m_pipeline(0),
 	m_pLearner(0),
-	m_debugImage(2*conf.searchRadius+1, 2*conf.searchRadius+1, CV_32FC1),
-	m_needsIntegralImage(false)
+	m_debugImage(2*conf.searchRadius+1, 2*conf.searchRadius+1, CV_32FC1)
 {
 	Reset();
 }
 
 Tracker::~Tracker()
 {
+	WaitForLearner();
 	delete m_pLearner;
-	for (int i = 0; i < (int)m_features.size(); ++i)
-	{
-		delete m_features[i];
-		delete m_kernels[i];
-	}
+	delete m_pipeline;
 }
 
 void Tracker::Reset()
 {
+	WaitForLearner();
 	m_initialised = false;
 	m_debugImage.setTo(0);
 	if (m_pLearner) delete m_pLearner;
-	for (int i = 0; i < (int)m_features.size(); ++i)
-	{
-		delete m_features[i];
-		delete m_kernels[i];
-	}
-	m_features.clear();
-	m_kernels.clear();
-	
-	m_needsIntegralImage = false;
-	m_needsIntegralHist = false;
-	
-	int numFeatures = m_config.features.size();
-	vector<int> featureCounts;
-	for (int i = 0; i < numFeatures; ++i)
-	{
-		switch (m_config.features[i].feature)
-		{
-		case Config::kFeatureTypeHaar:
-			m_features.push_back(new HaarFeatures(m_config));
-			m_needsIntegralImage = true;
-			break;			
-		case Config::kFeatureTypeRaw:
-			m_features.push_back(new RawFeatures(m_config));
-			break;
-		case Config::kFeatureTypeHistogram:
-			m_features.push_back(new HistogramFeatures(m_config));
-			m_needsIntegralHist = true;
-			break;
-		}
-		featureCounts.push_back(m_features.back()->GetCount());
-		
-		switch (m_config.features[i].kernel)
-		{
-		case Config::kKernelTypeLinear:
-			m_kernels.push_back(new LinearKernel());
-			break;
-		case Config::kKernelTypeGaussian:
-			m_kernels.push_back(new GaussianKernel(m_config.features[i].params[0]));
-			break;
-		case Config::kKernelTypeIntersection:
-			m_kernels.push_back(new IntersectionKernel());
-			break;
-		case Config::kKernelTypeChi2:
-			m_kernels.push_back(new Chi2Kernel());
-			break;
-		}
-	}
-	
-	if (numFeatures > 1)
-	{
-		MultiFeatures* f = new MultiFeatures(m_features);
-		m_features.push_back(f);
-		
-		MultiKernel* k = new MultiKernel(m_kernels, featureCounts);
-		m_kernels.push_back(k);		
-	}
+	if (m_pipeline) delete m_pipeline;
 	
-	m_pLearner = new LaRank(m_config, *m_features.back(), *m_kernels.back());
+	m_pipeline = Pipeline::Create(m_config);
+	m_pLearner = new LaRank(m_config, m_pipeline->GetFeatures(), m_pipeline->GetKernel(),
+		m_pipeline->GetEvalFeatures());
 }
+
 	
 
 void Tracker::Initialise(const cv::Mat& frame, FloatRect bb)
 {
 	m_bb = IntRect(bb);//ﴴһʱintαȻʹúϳɿm_bb
-	ImageRep image(frame, m_needsIntegralImage, m_needsIntegralHist);
+	ImageRep image(frame, m_pipeline->NeedsIntegralImage(), m_pipeline->NeedsIntegralHist());
 	for (int i = 0; i < 1; ++i)//?øforѭѭ1θ
 	{
-		UpdateLearner(image);
+		UpdateLearner(image, m_bb);
 	}
 	m_initialised = true;
 }
@@ -155,7 +94,7 @@ void Tracker::Track(const cv::Mat& frame)
 	assert(m_initialised);
 	//ͼѡhaarm_needsIntegralImage=truem_needsIntegralHist=false
 	//ͼΪ˷haar
-	ImageRep image(frame, m_needsIntegralImage, m_needsIntegralHist);
+	ImageRep image(frame, m_pipeline->NeedsIntegralImage(), m_pipeline->NeedsIntegralHist());
 	//һ֡οsearchRadiusΧڣnο򣬴vector
 	vector<FloatRect> rects = Sampler::PixelSamples(m_bb, m_config.searchRadius);
 	
@@ -192,7 +131,17 @@ void Tracker::Track(const cv::Mat& frame)
 	if (bestInd != -1)
 	{
 		m_bb = keptRects[bestInd];
-		UpdateLearner(image);//һҲȽϺʱ·
+		if (m_config.asyncUpdate)
+		{
+			// train on this frame while the next one is scored against the
+			// last published model, only one update runs at a time
+			WaitForLearner();
+			m_pendingUpdate = async(launch::async, &Tracker::UpdateLearner, this, image, m_bb);
+		}
+		else
+		{
+			UpdateLearner(image, m_bb);//һҲȽϺʱ·
+		}
 #if VERBOSE		
 		cout << "track score: " << bestScore << endl;
 #endif
@@ -216,13 +165,14 @@ void Tracker::UpdateDebugImage(const vector<FloatRect>& samples, const FloatRect
 void Tracker::Debug()
 {
 	imshow("tracker", m_debugImage);//ʾղUpdateDebugImageµm_debugImage
+	WaitForLearner();
 	m_pLearner->Debug();
 }
 
-void Tracker::UpdateLearner(const ImageRep& image)
+void Tracker::UpdateLearner(const ImageRep& image, FloatRect bb)
 {
 	// note these return the centre sample at index 0
-	vector<FloatRect> rects = Sampler::RadialSamples(m_bb, 2*m_config.searchRadius, 5, 16);
+	vector<FloatRect> rects = Sampler::RadialSamples(bb, 2*m_config.searchRadius, 5, 16);
 	//vector<FloatRect> rects = Sampler::PixelSamples(m_bb, 2*m_config.searchRadius, true);
 	
 	vector<FloatRect> keptRects;
@@ -240,3 +190,11 @@ void Tracker::UpdateLearner(const ImageRep& image)
 	MultiSample sample(image, keptRects);
 	m_pLearner->Update(sample, 0);//larank
 }
+
+void Tracker::WaitForLearner()
+{
+	if (m_pendingUpdate.valid())
+	{
+		m_pendingUpdate.get();
+	}
+}
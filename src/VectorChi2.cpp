@@ -0,0 +1,285 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "VectorChi2.h"
+
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_CHI2_X86 1
+#include <immintrin.h>
+#endif
+
+static const double kChi2Eps = 1e-8;
+
+template <typename T>
+static void Chi2Scalar(const T* x, int rows, int cols, int stride, const T* s, T* k, int start)
+{
+	for (int i = start; i < rows; ++i)
+	{
+		T sum = 0;
+		const T* xi = x+i;
+		for (int d = 0; d < cols; ++d, xi += stride)
+		{
+			T a = *xi;
+			T b = s[d];
+			sum += (a-b)*(a-b)/((T)0.5*(a+b)+(T)kChi2Eps);
+		}
+		k[i] = 1-sum;
+	}
+}
+
+#ifdef VECTOR_CHI2_X86
+
+// the candidates go down the vector lanes, so each feature of s is
+// broadcast once and a column of x is loaded contiguously. even and odd
+// features are summed separately, so consecutive terms don't wait on
+// each other.
+// a reciprocal estimate r of d is refined by r += r*(1 - d*r), which
+// doubles the number of correct bits each time.
+
+__attribute__((target("avx2,fma")))
+static inline __m256d Chi2Term(__m256d a, double s, __m256d acc)
+{
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d one = _mm256_set1_pd(1.0);
+	__m256d b = _mm256_set1_pd(s);
+	__m256d diff = _mm256_sub_pd(a, b);
+	__m256d den = _mm256_fmadd_pd(_mm256_add_pd(a, b), half, _mm256_set1_pd(kChi2Eps));
+	// 12 bit estimate in single precision, two steps give 46 bits
+	__m256d r = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(den)));
+	r = _mm256_fmadd_pd(r, _mm256_fnmadd_pd(den, r, one), r);
+	r = _mm256_fmadd_pd(r, _mm256_fnmadd_pd(den, r, one), r);
+	return _mm256_fmadd_pd(_mm256_mul_pd(diff, diff), r, acc);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 Chi2Term(__m256 a, float s, __m256 acc)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 b = _mm256_set1_ps(s);
+	__m256 diff = _mm256_sub_ps(a, b);
+	__m256 den = _mm256_fmadd_ps(_mm256_add_ps(a, b), half, _mm256_set1_ps((float)kChi2Eps));
+	// 12 bit estimate, one step gives 23 bits
+	__m256 r = _mm256_rcp_ps(den);
+	r = _mm256_fmadd_ps(r, _mm256_fnmadd_ps(den, r, one), r);
+	return _mm256_fmadd_ps(_mm256_mul_ps(diff, diff), r, acc);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d Chi2Term(__m512d a, double s, __m512d acc)
+{
+	const __m512d half = _mm512_set1_pd(0.5);
+	const __m512d one = _mm512_set1_pd(1.0);
+	__m512d b = _mm512_set1_pd(s);
+	__m512d diff = _mm512_sub_pd(a, b);
+	__m512d den = _mm512_fmadd_pd(_mm512_add_pd(a, b), half, _mm512_set1_pd(kChi2Eps));
+	// 14 bit estimate, two steps give full precision
+	__m512d r = _mm512_rcp14_pd(den);
+	r = _mm512_fmadd_pd(r, _mm512_fnmadd_pd(den, r, one), r);
+	r = _mm512_fmadd_pd(r, _mm512_fnmadd_pd(den, r, one), r);
+	return _mm512_fmadd_pd(_mm512_mul_pd(diff, diff), r, acc);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 Chi2Term(__m512 a, float s, __m512 acc)
+{
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 one = _mm512_set1_ps(1.0f);
+	__m512 b = _mm512_set1_ps(s);
+	__m512 diff = _mm512_sub_ps(a, b);
+	__m512 den = _mm512_fmadd_ps(_mm512_add_ps(a, b), half, _mm512_set1_ps((float)kChi2Eps));
+	// 14 bit estimate, one step gives full precision
+	__m512 r = _mm512_rcp14_ps(den);
+	r = _mm512_fmadd_ps(r, _mm512_fnmadd_ps(den, r, one), r);
+	return _mm512_fmadd_ps(_mm512_mul_ps(diff, diff), r, acc);
+}
+
+__attribute__((target("avx2,fma")))
+static void Chi2Avx2(const double* x, int rows, int cols, int stride, const double* s, double* k)
+{
+	int i = 0;
+	for (; i+4 <= rows; i += 4)
+	{
+		__m256d acc0 = _mm256_setzero_pd();
+		__m256d acc1 = _mm256_setzero_pd();
+		const double* xi = x+i;
+		int d = 0;
+		for (; d+2 <= cols; d += 2, xi += 2*stride)
+		{
+			acc0 = Chi2Term(_mm256_loadu_pd(xi), s[d], acc0);
+			acc1 = Chi2Term(_mm256_loadu_pd(xi+stride), s[d+1], acc1);
+		}
+		if (d < cols) acc0 = Chi2Term(_mm256_loadu_pd(xi), s[d], acc0);
+		_mm256_storeu_pd(k+i, _mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_add_pd(acc0, acc1)));
+	}
+	Chi2Scalar(x, rows, cols, stride, s, k, i);
+}
+
+__attribute__((target("avx2,fma")))
+static void Chi2Avx2(const float* x, int rows, int cols, int stride, const float* s, float* k)
+{
+	int i = 0;
+	for (; i+8 <= rows; i += 8)
+	{
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		const float* xi = x+i;
+		int d = 0;
+		for (; d+2 <= cols; d += 2, xi += 2*stride)
+		{
+			acc0 = Chi2Term(_mm256_loadu_ps(xi), s[d], acc0);
+			acc1 = Chi2Term(_mm256_loadu_ps(xi+stride), s[d+1], acc1);
+		}
+		if (d < cols) acc0 = Chi2Term(_mm256_loadu_ps(xi), s[d], acc0);
+		_mm256_storeu_ps(k+i, _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_add_ps(acc0, acc1)));
+	}
+	Chi2Scalar(x, rows, cols, stride, s, k, i);
+}
+
+// a false positive from inside gcc's _mm512 headers at -O2 and up
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+static void Chi2Avx512(const double* x, int rows, int cols, int stride, const double* s, double* k)
+{
+	for (int i = 0; i < rows; i += 8)
+	{
+		// the tail is done with a partial mask
+		__mmask8 m = (rows-i >= 8) ? (__mmask8)0xff : (__mmask8)((1 << (rows-i))-1);
+		__m512d acc0 = _mm512_setzero_pd();
+		__m512d acc1 = _mm512_setzero_pd();
+		const double* xi = x+i;
+		int d = 0;
+		for (; d+2 <= cols; d += 2, xi += 2*stride)
+		{
+			acc0 = Chi2Term(_mm512_maskz_loadu_pd(m, xi), s[d], acc0);
+			acc1 = Chi2Term(_mm512_maskz_loadu_pd(m, xi+stride), s[d+1], acc1);
+		}
+		if (d < cols) acc0 = Chi2Term(_mm512_maskz_loadu_pd(m, xi), s[d], acc0);
+		_mm512_mask_storeu_pd(k+i, m, _mm512_sub_pd(_mm512_set1_pd(1.0), _mm512_add_pd(acc0, acc1)));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void Chi2Avx512(const float* x, int rows, int cols, int stride, const float* s, float* k)
+{
+	for (int i = 0; i < rows; i += 16)
+	{
+		// the tail is done with a partial mask
+		__mmask16 m = (rows-i >= 16) ? (__mmask16)0xffff : (__mmask16)((1 << (rows-i))-1);
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		const float* xi = x+i;
+		int d = 0;
+		for (; d+2 <= cols; d += 2, xi += 2*stride)
+		{
+			acc0 = Chi2Term(_mm512_maskz_loadu_ps(m, xi), s[d], acc0);
+			acc1 = Chi2Term(_mm512_maskz_loadu_ps(m, xi+stride), s[d+1], acc1);
+		}
+		if (d < cols) acc0 = Chi2Term(_mm512_maskz_loadu_ps(m, xi), s[d], acc0);
+		_mm512_mask_storeu_ps(k+i, m, _mm512_sub_ps(_mm512_set1_ps(1.0f), _mm512_add_ps(acc0, acc1)));
+	}
+}
+#pragma GCC diagnostic pop
+
+#endif
+
+template <typename T>
+static void Chi2Fallback(const T* x, int rows, int cols, int stride, const T* s, T* k)
+{
+	Chi2Scalar(x, rows, cols, stride, s, k, 0);
+}
+
+template <typename T>
+struct Chi2Function
+{
+	typedef void (*Type)(const T*, int, int, int, const T*, T*);
+	
+	// null if the cpu can't run path
+	static Type Get(Chi2Path path)
+	{
+		switch (path)
+		{
+		case kChi2Scalar:
+			return Chi2Fallback<T>;
+#ifdef VECTOR_CHI2_X86
+		case kChi2Avx2:
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Chi2Avx2;
+			break;
+		case kChi2Avx512:
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f")) return Chi2Avx512;
+			break;
+#endif
+		default:
+			break;
+		}
+		return 0;
+	}
+	
+	static Type Choose()
+	{
+		if (Type f = Get(kChi2Avx512)) return f;
+		if (Type f = Get(kChi2Avx2)) return f;
+		return Get(kChi2Scalar);
+	}
+};
+
+void Chi2Column(const double* x, int rows, int cols, int stride, const double* s, double* k)
+{
+	static const Chi2Function<double>::Type f = Chi2Function<double>::Choose();
+	f(x, rows, cols, stride, s, k);
+}
+
+void Chi2Column(const float* x, int rows, int cols, int stride, const float* s, float* k)
+{
+	static const Chi2Function<float>::Type f = Chi2Function<float>::Choose();
+	f(x, rows, cols, stride, s, k);
+}
+
+bool Chi2Supported(Chi2Path path)
+{
+	return Chi2Function<double>::Get(path) != 0;
+}
+
+void Chi2Column(Chi2Path path, const double* x, int rows, int cols, int stride, const double* s, double* k)
+{
+	Chi2Function<double>::Type f = Chi2Function<double>::Get(path);
+	assert(f);
+	f(x, rows, cols, stride, s, k);
+}
+
+void Chi2Column(Chi2Path path, const float* x, int rows, int cols, int stride, const float* s, float* k)
+{
+	Chi2Function<float>::Type f = Chi2Function<float>::Get(path);
+	assert(f);
+	f(x, rows, cols, stride, s, k);
+}
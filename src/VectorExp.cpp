@@ -0,0 +1,179 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "VectorExp.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_EXP_X86 1
+#include <immintrin.h>
+#endif
+
+// exp(x) = 2^n*exp(r) with n = round(x/ln2) and |r| <= ln2/2, exp(r) is
+// then a taylor polynomial. the degree 12 one has a truncation error
+// < 2e-16, the degree 6 one used by VectorExpFast < 1.7e-7 relative
+static const double kLog2e = 1.4426950408889634;
+static const double kLn2Hi = 6.93147180369123816490e-01;
+static const double kLn2Lo = 1.90821492927058770002e-10;
+static const double kExpMin = -708.0; // below this the result is flushed to zero
+static const double kExpMax = 709.0;
+// exp(-40) < 5e-18, which is lost against anything of order 1
+static const double kFastExpMin = -40.0;
+// the coefficients of degree d are the last d+1 of these
+static const double kExpCoeffs[] = {
+	1.0/479001600.0, 1.0/39916800.0, 1.0/3628800.0, 1.0/362880.0,
+	1.0/40320.0, 1.0/5040.0, 1.0/720.0, 1.0/120.0,
+	1.0/24.0, 1.0/6.0, 1.0/2.0, 1.0, 1.0
+};
+static const int kExpDegree = 12;
+static const int kFastExpDegree = 6;
+
+static inline double ExpFloor(int degree)
+{
+	return degree == kExpDegree ? kExpMin : kFastExpMin;
+}
+
+static void ExpScalar(double* x, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		x[i] = std::exp(x[i]);
+	}
+}
+
+template <int Degree>
+static void ExpScalarFlushed(double* x, int n)
+{
+	const double lo = ExpFloor(Degree);
+	for (int i = 0; i < n; ++i)
+	{
+		x[i] = x[i] < lo ? 0.0 : std::exp(x[i]);
+	}
+}
+
+#ifdef VECTOR_EXP_X86
+
+template <int Degree>
+__attribute__((target("avx2,fma")))
+static void ExpAvx2(double* x, int n)
+{
+	const __m256d log2e = _mm256_set1_pd(kLog2e);
+	const __m256d ln2Hi = _mm256_set1_pd(kLn2Hi);
+	const __m256d ln2Lo = _mm256_set1_pd(kLn2Lo);
+	const __m256d lo = _mm256_set1_pd(ExpFloor(Degree));
+	const __m256d hi = _mm256_set1_pd(kExpMax);
+	const __m128i bias = _mm_set1_epi32(1023);
+	int i = 0;
+	for (; i+4 <= n; i += 4)
+	{
+		__m256d v = _mm256_loadu_pd(x+i);
+		__m256d under = _mm256_cmp_pd(v, lo, _CMP_LT_OQ);
+		v = _mm256_min_pd(_mm256_max_pd(v, lo), hi);
+		__m256d k = _mm256_round_pd(_mm256_mul_pd(v, log2e), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d r = _mm256_fnmadd_pd(k, ln2Hi, v);
+		r = _mm256_fnmadd_pd(k, ln2Lo, r);
+		const double* coeffs = kExpCoeffs + kExpDegree-Degree;
+		__m256d p = _mm256_set1_pd(coeffs[0]);
+		for (int c = 1; c <= Degree; ++c)
+		{
+			p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(coeffs[c]));
+		}
+		// 2^k built directly in the exponent bits
+		__m128i e = _mm_add_epi32(_mm256_cvtpd_epi32(k), bias);
+		__m256i bits = _mm256_slli_epi64(_mm256_cvtepi32_epi64(e), 52);
+		p = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+		_mm256_storeu_pd(x+i, _mm256_andnot_pd(under, p));
+	}
+	ExpScalarFlushed<Degree>(x+i, n-i);
+}
+
+// avx512fintrin.h itself trips gcc's -Wmaybe-uninitialized once inlined here
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <int Degree>
+__attribute__((target("avx512f")))
+static void ExpAvx512(double* x, int n)
+{
+	const __m512d log2e = _mm512_set1_pd(kLog2e);
+	const __m512d ln2Hi = _mm512_set1_pd(kLn2Hi);
+	const __m512d ln2Lo = _mm512_set1_pd(kLn2Lo);
+	const __m512d lo = _mm512_set1_pd(ExpFloor(Degree));
+	const __m512d hi = _mm512_set1_pd(kExpMax);
+	const __m256i bias = _mm256_set1_epi32(1023);
+	for (int i = 0; i < n; i += 8)
+	{
+		// the tail is done with a partial mask
+		__mmask8 m = (n-i >= 8) ? (__mmask8)0xff : (__mmask8)((1 << (n-i))-1);
+		__m512d v = _mm512_maskz_loadu_pd(m, x+i);
+		__mmask8 over = _mm512_cmp_pd_mask(v, lo, _CMP_GE_OQ);
+		v = _mm512_min_pd(_mm512_max_pd(v, lo), hi);
+		__m512d k = _mm512_roundscale_pd(_mm512_mul_pd(v, log2e), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m512d r = _mm512_fnmadd_pd(k, ln2Hi, v);
+		r = _mm512_fnmadd_pd(k, ln2Lo, r);
+		const double* coeffs = kExpCoeffs + kExpDegree-Degree;
+		__m512d p = _mm512_set1_pd(coeffs[0]);
+		for (int c = 1; c <= Degree; ++c)
+		{
+			p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(coeffs[c]));
+		}
+		// 2^k built directly in the exponent bits
+		__m256i e = _mm256_add_epi32(_mm512_cvtpd_epi32(k), bias);
+		__m512i bits = _mm512_slli_epi64(_mm512_cvtepi32_epi64(e), 52);
+		p = _mm512_mul_pd(p, _mm512_castsi512_pd(bits));
+		_mm512_mask_storeu_pd(x+i, m, _mm512_maskz_mov_pd(over, p));
+	}
+}
+#pragma GCC diagnostic pop
+
+#endif
+
+typedef void (*ExpFunction)(double*, int);
+
+template <int Degree>
+static ExpFunction ChooseExp()
+{
+#ifdef VECTOR_EXP_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return ExpAvx512<Degree>;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return ExpAvx2<Degree>;
+#endif
+	return Degree == kExpDegree ? ExpScalar : ExpScalarFlushed<Degree>;
+}
+
+void VectorExp(double* x, int n)
+{
+	static const ExpFunction f = ChooseExp<kExpDegree>();
+	f(x, n);
+}
+
+void VectorExpFast(double* x, int n)
+{
+	static const ExpFunction f = ChooseExp<kFastExpDegree>();
+	f(x, n);
+}
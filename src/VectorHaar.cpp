@@ -0,0 +1,225 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+#include "VectorHaar.h"
+
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_HAAR_X86 1
+#include <immintrin.h>
+#endif
+
+// boxes start to n of feature d, rects begin to end-1
+static inline void HaarScalar(const int* base, int start, int n, int begin, int end, const int* offsets,
+	const float* weights, float norm, double* out)
+{
+	for (int i = start; i < n; ++i)
+	{
+		const int* b = base+i;
+		float value = 0.f;
+		for (int j = begin; j < end; ++j)
+		{
+			const int* c = offsets+4*j;
+			value += weights[j]*(b[c[0]] + b[c[1]] - b[c[2]] - b[c[3]]);
+		}
+		out[i] = value / norm;
+	}
+}
+
+static void HaarRowScalar(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	for (int d = 0; d < count; ++d)
+	{
+		HaarScalar(base, 0, n, first[d], first[d+1], offsets, weights, norms[d], out+d*stride);
+	}
+}
+
+#ifdef VECTOR_HAAR_X86
+
+// neighbouring boxes read neighbouring integral image values, so each
+// corner of a rect is a single unaligned load for all the lanes. the sum
+// is weighted with a separate multiply and add, as in the scalar code.
+
+__attribute__((target("sse4.1")))
+static void HaarRowSse4(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	for (int d = 0; d < count; ++d)
+	{
+		double* o = out+d*stride;
+		const __m128 norm = _mm_set1_ps(norms[d]);
+		int i = 0;
+		for (; i+4 <= n; i += 4)
+		{
+			const int* b = base+i;
+			__m128 value = _mm_setzero_ps();
+			for (int j = first[d]; j < first[d+1]; ++j)
+			{
+				const int* c = offsets+4*j;
+				__m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(b+c[0])), _mm_loadu_si128((const __m128i*)(b+c[1])));
+				sum = _mm_sub_epi32(sum, _mm_loadu_si128((const __m128i*)(b+c[2])));
+				sum = _mm_sub_epi32(sum, _mm_loadu_si128((const __m128i*)(b+c[3])));
+				value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(weights[j]), _mm_cvtepi32_ps(sum)));
+			}
+			value = _mm_div_ps(value, norm);
+			_mm_storeu_pd(o+i, _mm_cvtps_pd(value));
+			_mm_storeu_pd(o+i+2, _mm_cvtps_pd(_mm_movehl_ps(value, value)));
+		}
+		HaarScalar(base, i, n, first[d], first[d+1], offsets, weights, norms[d], o);
+	}
+}
+
+__attribute__((target("avx2")))
+static void HaarRowAvx2(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	for (int d = 0; d < count; ++d)
+	{
+		double* o = out+d*stride;
+		const __m256 norm = _mm256_set1_ps(norms[d]);
+		int i = 0;
+		for (; i+8 <= n; i += 8)
+		{
+			const int* b = base+i;
+			__m256 value = _mm256_setzero_ps();
+			for (int j = first[d]; j < first[d+1]; ++j)
+			{
+				const int* c = offsets+4*j;
+				__m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(b+c[0])), _mm256_loadu_si256((const __m256i*)(b+c[1])));
+				sum = _mm256_sub_epi32(sum, _mm256_loadu_si256((const __m256i*)(b+c[2])));
+				sum = _mm256_sub_epi32(sum, _mm256_loadu_si256((const __m256i*)(b+c[3])));
+				value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(weights[j]), _mm256_cvtepi32_ps(sum)));
+			}
+			value = _mm256_div_ps(value, norm);
+			_mm256_storeu_pd(o+i, _mm256_cvtps_pd(_mm256_castps256_ps128(value)));
+			_mm256_storeu_pd(o+i+4, _mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)));
+		}
+		HaarScalar(base, i, n, first[d], first[d+1], offsets, weights, norms[d], o);
+	}
+}
+
+// gcc warns inside its own avx-512 headers for this one. avx-512 also
+// brings fma, which gcc would fuse the multiply and add into, rounding
+// once where the other paths round twice
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+static void HaarRowAvx512(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	for (int d = 0; d < count; ++d)
+	{
+		double* o = out+d*stride;
+		const __m512 norm = _mm512_set1_ps(norms[d]);
+		for (int i = 0; i < n; i += 16)
+		{
+			// the tail is done with a partial mask
+			__mmask16 m = (n-i >= 16) ? (__mmask16)0xffff : (__mmask16)((1 << (n-i))-1);
+			const int* b = base+i;
+			__m512 value = _mm512_setzero_ps();
+			for (int j = first[d]; j < first[d+1]; ++j)
+			{
+				const int* c = offsets+4*j;
+				__m512i sum = _mm512_add_epi32(_mm512_maskz_loadu_epi32(m, b+c[0]), _mm512_maskz_loadu_epi32(m, b+c[1]));
+				sum = _mm512_sub_epi32(sum, _mm512_maskz_loadu_epi32(m, b+c[2]));
+				sum = _mm512_sub_epi32(sum, _mm512_maskz_loadu_epi32(m, b+c[3]));
+				value = _mm512_add_ps(value, _mm512_mul_ps(_mm512_set1_ps(weights[j]), _mm512_cvtepi32_ps(sum)));
+			}
+			value = _mm512_div_ps(value, norm);
+			__m256 lo = _mm512_castps512_ps256(value);
+			__m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(value), 1));
+			_mm512_mask_storeu_pd(o+i, (__mmask8)m, _mm512_cvtps_pd(lo));
+			_mm512_mask_storeu_pd(o+i+8, (__mmask8)(m >> 8), _mm512_cvtps_pd(hi));
+		}
+	}
+}
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+
+#endif
+
+typedef void (*HaarFunction)(const int*, int, const int*, const int*, const float*, const float*, int, double*, int);
+
+// null if the cpu can't run path
+static HaarFunction GetHaar(HaarPath path)
+{
+	switch (path)
+	{
+	case kHaarScalar:
+		return HaarRowScalar;
+#ifdef VECTOR_HAAR_X86
+	case kHaarSse4:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse4.1")) return HaarRowSse4;
+		break;
+	case kHaarAvx2:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return HaarRowAvx2;
+		break;
+	case kHaarAvx512:
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return HaarRowAvx512;
+		break;
+#endif
+	default:
+		break;
+	}
+	return 0;
+}
+
+static HaarFunction ChooseHaar()
+{
+	if (HaarFunction f = GetHaar(kHaarAvx512)) return f;
+	if (HaarFunction f = GetHaar(kHaarAvx2)) return f;
+	if (HaarFunction f = GetHaar(kHaarSse4)) return f;
+	return GetHaar(kHaarScalar);
+}
+
+void HaarRow(const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	static const HaarFunction f = ChooseHaar();
+	f(base, n, first, offsets, weights, norms, count, out, stride);
+}
+
+bool HaarSupported(HaarPath path)
+{
+	return GetHaar(path) != 0;
+}
+
+void HaarRow(HaarPath path, const int* base, int n, const int* first, const int* offsets, const float* weights,
+	const float* norms, int count, double* out, int stride)
+{
+	HaarFunction f = GetHaar(path);
+	assert(f);
+	f(base, n, first, offsets, weights, norms, count, out, stride);
+}
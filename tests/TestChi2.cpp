@@ -0,0 +1,195 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+// checks Chi2Column against Chi2Kernel::Eval on every implementation this
+// cpu can run, for each tail length up to 20 rows past the last full
+// vector, with empty bins and bins equal to the support vector's.
+// built once as is and once with STRUCK_FLOAT, whose kernel blocks take
+// the single precision path.
+
+#include "Kernels.h"
+#include "VectorChi2.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// max abs error against Eval measured on these paths, above which a test fails
+static const double kDoubleTolerance = 8e-15;
+static const double kFloatTolerance = 3e-6;
+
+// 30 cells of 16 bins, as HistogramFeatures gives
+static const int kCells = 30;
+static const int kBins = 16;
+static const int kDims = kCells*kBins;
+
+static const char* kPathNames[] = { "scalar", "avx2", "avx512" };
+
+// histogram with about a third of its bins empty, each cell summing to 1/kCells
+template <typename T>
+static void RandomHistogram(T* h)
+{
+	for (int c = 0; c < kCells; ++c)
+	{
+		double sum = 0.0;
+		for (int b = 0; b < kBins; ++b)
+		{
+			double v = (rand() % 3 == 0) ? 0.0 : (double)rand()/RAND_MAX;
+			h[c*kBins+b] = (T)v;
+			sum += v;
+		}
+		for (int b = 0; b < kBins; ++b)
+		{
+			h[c*kBins+b] = (sum > 0.0) ? (T)(h[c*kBins+b]/(sum*kCells)) : (T)0;
+		}
+	}
+}
+
+// candidates as rows of a column-major block with stride > rows, the first
+// equal to s and the rest sharing a quarter of their bins with it
+template <typename T>
+static void MakeBlock(int rows, int stride, std::vector<T>& x, std::vector<T>& s, std::vector<double>& expected)
+{
+	Chi2Kernel kernel;
+	std::vector<T> h(kDims);
+	std::vector<double> xd(kDims), sd(kDims);
+
+	s.resize(kDims);
+	RandomHistogram(&s[0]);
+	x.assign(kDims*stride, (T)0);
+	expected.resize(rows);
+	for (int i = 0; i < rows; ++i)
+	{
+		RandomHistogram(&h[0]);
+		for (int d = 0; d < kDims; ++d)
+		{
+			if (i == 0 || rand() % 4 == 0) h[d] = s[d];
+			x[d*stride+i] = h[d];
+			xd[d] = h[d];
+			sd[d] = s[d];
+		}
+		expected[i] = kernel.Eval(&xd[0], &sd[0], kDims);
+	}
+}
+
+template <typename T>
+static double MaxError(const std::vector<T>& k, const std::vector<double>& expected)
+{
+	double err = 0.0;
+	for (int i = 0; i < (int)expected.size(); ++i)
+	{
+		// nan fails too
+		double e = std::fabs((double)k[i]-expected[i]);
+		if (!(e <= err)) err = e;
+	}
+	return err;
+}
+
+template <typename T>
+static bool TestPaths(const char* type, double tolerance)
+{
+	bool ok = true;
+	for (int p = kChi2Scalar; p <= kChi2Avx512; ++p)
+	{
+		Chi2Path path = (Chi2Path)p;
+		if (!Chi2Supported(path))
+		{
+			printf("%s %s: not supported, skipped\n", type, kPathNames[p]);
+			continue;
+		}
+
+		// every tail of 1 to 20 rows, alone and after a full vector of
+		// up to 16 floats
+		double err = 0.0;
+		for (int rows = 1; rows <= 16+20; ++rows)
+		{
+			std::vector<T> x, s;
+			std::vector<double> expected;
+			MakeBlock(rows, rows+3, x, s, expected);
+			std::vector<T> k(rows);
+			Chi2Column(path, &x[0], rows, kDims, rows+3, &s[0], &k[0]);
+			double e = MaxError(k, expected);
+			if (!(e <= err)) err = e;
+		}
+		bool pass = err <= tolerance;
+		printf("%s %s: max error %g%s\n", type, kPathNames[p], err, pass ? "" : " FAILED");
+		ok = ok && pass;
+	}
+	return ok;
+}
+
+// the kernel block the tracker evaluates, in the precision it was built with
+static bool TestEvalBlock(double tolerance)
+{
+	const int rows = 131;
+	const int svs = 7;
+	Chi2Kernel kernel;
+	std::vector<feature_t> x, s;
+	std::vector<double> expected;
+	std::vector<feature_t> S(svs*kDims);
+	std::vector<feature_t> K(rows*svs);
+	double err = 0.0;
+
+	MakeBlock(rows, rows, x, s, expected);
+	std::vector<double> xd(kDims), sd(kDims);
+	for (int j = 0; j < svs; ++j)
+	{
+		RandomHistogram(&S[j*kDims]);
+	}
+	ViewXd none(0, 0, 0, 0);
+	kernel.EvalBlock(MatrixView<feature_t>(&x[0], rows, kDims, rows), none,
+		MatrixView<feature_t, Eigen::RowMajor>(&S[0], svs, kDims, kDims), none,
+		MatrixView<feature_t>(&K[0], rows, svs, rows));
+	for (int j = 0; j < svs; ++j)
+	{
+		for (int i = 0; i < rows; ++i)
+		{
+			for (int d = 0; d < kDims; ++d)
+			{
+				xd[d] = x[d*rows+i];
+				sd[d] = S[j*kDims+d];
+			}
+			double e = std::fabs((double)K[j*rows+i]-kernel.Eval(&xd[0], &sd[0], kDims));
+			if (!(e <= err)) err = e;
+		}
+	}
+	bool pass = err <= tolerance;
+	printf("EvalBlock (feature_t %s): max error %g%s\n", sizeof(feature_t) == sizeof(float) ? "float" : "double",
+		err, pass ? "" : " FAILED");
+	return pass;
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+	bool ok = TestPaths<double>("double", kDoubleTolerance);
+	ok = TestPaths<float>("float", kFloatTolerance) && ok;
+	ok = TestEvalBlock(sizeof(feature_t) == sizeof(float) ? kFloatTolerance : kDoubleTolerance) && ok;
+	return ok ? 0 : 1;
+}
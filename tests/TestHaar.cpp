@@ -0,0 +1,162 @@
+/* 
+ * Struck: Structured Output Tracking with Kernels
+ * 
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ * 
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ * 
+ * This file is part of Struck.
+ * 
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ */
+
+
+// checks that every implementation of HaarRow this cpu can run gives
+// exactly the scalar result for runs of 1 to 40 boxes, which covers each
+// tail after the 4, 8 and 16 wide loops, and writes nothing past the run.
+
+#include "VectorHaar.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const int kWidth = 80;
+static const int kHeight = 40;
+static const int kStride = kWidth+1;//of the integral image
+static const int kMaxRun = 40;
+static const int kBoxSize = 24;
+static const int kGuard = 5;//unwritten values kept after each run
+static const double kUnwritten = -12345.0;
+
+static const char* kPathNames[] = { "scalar", "sse4.1", "avx2", "avx512" };
+
+// the feature layout HaarRow is handed by HaarFeatures
+struct HaarTable
+{
+	std::vector<int> first;
+	std::vector<int> offsets;
+	std::vector<float> weights;
+	std::vector<float> norms;
+};
+
+static void AddRect(HaarTable& t, int x, int y, int w, int h, float weight)
+{
+	// c[0]+c[1]-c[2]-c[3] is the sum over the rect
+	t.offsets.push_back(y*kStride+x);
+	t.offsets.push_back((y+h)*kStride+x+w);
+	t.offsets.push_back(y*kStride+x+w);
+	t.offsets.push_back((y+h)*kStride+x);
+	t.weights.push_back(weight);
+}
+
+// random features of two to four rects inside the box, with the weights
+// the haar types use and one that isn't a whole number
+static void MakeTable(HaarTable& t, int count)
+{
+	static const float kWeights[] = { 1.f, -1.f, -2.f, 0.37f };
+	t.first.push_back(0);
+	for (int d = 0; d < count; ++d)
+	{
+		int rects = 2 + rand() % 3;
+		int area = 0;
+		for (int j = 0; j < rects; ++j)
+		{
+			int x = rand() % (kBoxSize-1);
+			int y = rand() % (kBoxSize-1);
+			int w = 1 + rand() % (kBoxSize-x);
+			int h = 1 + rand() % (kBoxSize-y);
+			AddRect(t, x, y, w, h, kWeights[rand() % 4]);
+			area += w*h;
+		}
+		t.first.push_back(t.first.back()+rects);
+		t.norms.push_back(255.f*area/rects);
+	}
+}
+
+// the formula HaarRow is documented to compute, in its precision
+static double Expected(const int* base, const HaarTable& t, int d, int i)
+{
+	const int* b = base+i;
+	float value = 0.f;
+	for (int j = t.first[d]; j < t.first[d+1]; ++j)
+	{
+		const int* c = &t.offsets[4*j];
+		value += t.weights[j]*(b[c[0]] + b[c[1]] - b[c[2]] - b[c[3]]);
+	}
+	return value / t.norms[d];
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+
+	// integral image of random pixels
+	std::vector<int> integral(kStride*(kHeight+1), 0);
+	for (int y = 0; y < kHeight; ++y)
+	{
+		for (int x = 0; x < kWidth; ++x)
+		{
+			integral[(y+1)*kStride+x+1] = rand() % 256 + integral[y*kStride+x+1]
+				+ integral[(y+1)*kStride+x] - integral[y*kStride+x];
+		}
+	}
+
+	const int count = 12;
+	HaarTable t;
+	MakeTable(t, count);
+
+	bool ok = true;
+	for (int p = kHaarScalar; p <= kHaarAvx512; ++p)
+	{
+		HaarPath path = (HaarPath)p;
+		if (!HaarSupported(path))
+		{
+			printf("%s: not supported, skipped\n", kPathNames[p]);
+			continue;
+		}
+
+		int mismatches = 0;
+		int overwrites = 0;
+		for (int n = 1; n <= kMaxRun; ++n)
+		{
+			// the start moves with n so the loads land at every alignment
+			const int* base = &integral[3*kStride+1+n%5];
+			int stride = n+kGuard;
+			std::vector<double> out(count*stride+kGuard, kUnwritten);
+			HaarRow(path, base, n, &t.first[0], &t.offsets[0], &t.weights[0], &t.norms[0], count, &out[0], stride);
+			for (int d = 0; d < count; ++d)
+			{
+				for (int i = 0; i < stride; ++i)
+				{
+					double v = out[d*stride+i];
+					if (i < n && v != Expected(base, t, d, i)) ++mismatches;
+					if (i >= n && v != kUnwritten) ++overwrites;
+				}
+			}
+			for (int i = count*stride; i < (int)out.size(); ++i)
+			{
+				if (out[i] != kUnwritten) ++overwrites;
+			}
+		}
+		bool pass = mismatches == 0 && overwrites == 0;
+		printf("%s: %d mismatches, %d writes past the run%s\n", kPathNames[p], mismatches, overwrites, pass ? "" : " FAILED");
+		ok = ok && pass;
+	}
+	return ok ? 0 : 1;
+}